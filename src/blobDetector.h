@@ -0,0 +1,344 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+#if defined(_M_X64) || defined(__SSE2__)
+#include <emmintrin.h>
+#define BLOBDETECTOR_SSE2 1
+#endif
+
+struct Blob {
+	// intensity-weighted centroid, pixel (x, y) covers [x, x+1) x [y, y+1)
+	float cx, cy;
+	// weighted central second moments and the major axis angle they give (radians)
+	float mxx, myy, mxy;
+	float angle;
+	int area;	// number of pixels above the threshold
+	cv::Rect bbox;
+	uint8_t peak;	// brightest pixel
+};
+
+/*
+ Fingertip detector: threshold + 8-connected component labelling in one
+ run-length encoded scan.
+
+ Each row is reduced to runs of lit pixels (dark spans are skipped 16
+ pixels at a time), runs are merged with the overlapping runs of the row
+ above through union-find, and the per-run sums are folded into their
+ component at the end. All work after the scan is proportional to the
+ number of runs, not to the image size.
+
+ Every lit pixel is weighted by how far it rises above the threshold, so
+ the moments follow the brightness profile of the fingertip instead of the
+ jagged outline of the thresholded shape and give sub-pixel centroids.
+
+ Given the tiles the preprocessing recomputed, only those are scanned,
+ grown by every lit tile connected to them so no component is cut at the
+ border, and by the boxes of last frame's blobs that reach into them.
+ Blobs entirely outside are carried over from the previous frame.
+*/
+class BlobDetector
+{
+public:
+	BlobDetector()
+		: threshold_(128),
+		minArea_(0),
+		maxArea_(INT32_MAX),
+		stale_(true) {}
+
+	// same meaning as ofxCv::ContourFinder: pixels > threshold are lit,
+	// area bounds are given as radii of the equivalent circle
+	void SetThreshold(int threshold) {
+		threshold = std::min(std::max(threshold, 0), 255);
+		stale_ |= threshold != threshold_;
+		threshold_ = threshold;
+	}
+	void SetMinAreaRadius(float radius) { SetArea(minArea_, (int)(PI_F * radius * radius)); }
+	void SetMaxAreaRadius(float radius) { SetArea(maxArea_, (int)(PI_F * radius * radius)); }
+
+	const std::vector<Blob>& Detect(const cv::Mat& gray) {
+		runs_.clear();
+		blobs_.clear();
+
+		// threshold 255 can never be exceeded
+		if (threshold_ < 255) {
+			int prevBegin = 0, prevEnd = 0;
+			for (int y = 0; y < gray.rows; y++) {
+				const int begin = (int)runs_.size();
+				ScanRow(gray.ptr<uint8_t>(y), 0, gray.cols, y);
+				const int end = (int)runs_.size();
+				Connect(prevBegin, prevEnd, begin, end);
+				prevBegin = begin;
+				prevEnd = end;
+			}
+		}
+
+		Collect();
+		stale_ = false;
+		return blobs_;
+	}
+
+	// gray changed only in the tiles flagged in changed; tileMax is the
+	// brightest pixel of every tile, both row major tileSize x tileSize tiles
+	const std::vector<Blob>& Detect(const cv::Mat& gray, const std::vector<uint8_t>& changed,
+		const std::vector<uint8_t>& tileMax, int tileSize) {
+		const int tileCols = (gray.cols + tileSize - 1) / tileSize;
+		const int tileRows = (gray.rows + tileSize - 1) / tileSize;
+		if (stale_ || (int)changed.size() != tileCols * tileRows || tileMax.size() != changed.size())
+			return Detect(gray);
+
+		FindScanTiles(changed, tileMax, tileCols, tileRows, tileSize);
+
+		kept_.clear();
+		for (const auto& blob : blobs_) {
+			if (!Overlaps(blob.bbox, tileCols, tileSize))
+				kept_.push_back(blob);
+		}
+
+		runs_.clear();
+		blobs_.clear();
+		if (threshold_ < 255) {
+			int prevBegin = 0, prevEnd = 0;
+			for (int y = 0; y < gray.rows; y++) {
+				const uint8_t* row = gray.ptr<uint8_t>(y);
+				const uint8_t* scan = &scan_[(y / tileSize) * tileCols];
+				const int begin = (int)runs_.size();
+				for (int tx = 0; tx < tileCols;) {
+					if (!scan[tx]) {
+						tx++;
+						continue;
+					}
+					const int x0 = tx;
+					while (tx < tileCols && scan[tx])
+						tx++;
+					ScanRow(row, x0 * tileSize, std::min(tx * tileSize, gray.cols), y);
+				}
+				const int end = (int)runs_.size();
+				Connect(prevBegin, prevEnd, begin, end);
+				prevBegin = begin;
+				prevEnd = end;
+			}
+		}
+
+		Collect();
+		blobs_.insert(blobs_.end(), kept_.begin(), kept_.end());
+		return blobs_;
+	}
+
+	const std::vector<Blob>& Blobs() const { return blobs_; }
+
+private:
+	static constexpr float PI_F = 3.14159265f;
+
+	struct Run {
+		int y, x0, x1;	// [x0, x1)
+		int parent;
+		uint8_t peak;
+		// sums of w, w*x and w*x*x along the run
+		int64_t w, wx, wxx;
+	};
+
+	void SetArea(int& area, int value) {
+		stale_ |= area != value;
+		area = value;
+	}
+
+	// scan_ = changed tiles, plus every lit tile 8-connected to them and the
+	// boxes of previous blobs they reach, until neither adds anything
+	void FindScanTiles(const std::vector<uint8_t>& changed, const std::vector<uint8_t>& tileMax,
+		int tileCols, int tileRows, int tileSize) {
+		scan_ = changed;
+		stack_.clear();
+		for (int i = 0; i < (int)scan_.size(); i++) {
+			if (scan_[i]) stack_.push_back(i);
+		}
+
+		for (;;) {
+			while (!stack_.empty()) {
+				const int i = stack_.back();
+				stack_.pop_back();
+				const int tx = i % tileCols, ty = i / tileCols;
+				for (int y = std::max(ty - 1, 0); y <= std::min(ty + 1, tileRows - 1); y++) {
+					for (int x = std::max(tx - 1, 0); x <= std::min(tx + 1, tileCols - 1); x++) {
+						const int j = y * tileCols + x;
+						if (!scan_[j] && tileMax[j] > threshold_) {
+							scan_[j] = 1;
+							stack_.push_back(j);
+						}
+					}
+				}
+			}
+
+			for (const auto& blob : blobs_) {
+				if (!Overlaps(blob.bbox, tileCols, tileSize)) continue;
+				for (int y = blob.bbox.y / tileSize; y <= (blob.bbox.y + blob.bbox.height - 1) / tileSize; y++) {
+					for (int x = blob.bbox.x / tileSize; x <= (blob.bbox.x + blob.bbox.width - 1) / tileSize; x++) {
+						const int j = y * tileCols + x;
+						if (!scan_[j]) {
+							scan_[j] = 1;
+							stack_.push_back(j);
+						}
+					}
+				}
+			}
+			if (stack_.empty())
+				break;
+		}
+	}
+
+	bool Overlaps(const cv::Rect& bbox, int tileCols, int tileSize) const {
+		for (int y = bbox.y / tileSize; y <= (bbox.y + bbox.height - 1) / tileSize; y++) {
+			for (int x = bbox.x / tileSize; x <= (bbox.x + bbox.width - 1) / tileSize; x++) {
+				if (scan_[y * tileCols + x]) return true;
+			}
+		}
+		return false;
+	}
+
+	// runs of lit pixels in [x0, cols)
+	void ScanRow(const uint8_t* row, int x0, int cols, int y) {
+		const uint8_t t = (uint8_t)threshold_;
+		int x = x0;
+		while (x < cols) {
+			// skip dark pixels
+#ifdef BLOBDETECTOR_SSE2
+			const __m128i vt = _mm_set1_epi8((char)t);
+			const __m128i zero = _mm_setzero_si128();
+			while (x + 16 <= cols) {
+				__m128i p = _mm_loadu_si128((const __m128i*)(row + x));
+				// p > t  <=>  saturating p - t is non-zero
+				if (_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_subs_epu8(p, vt), zero)) != 0xFFFF)
+					break;
+				x += 16;
+			}
+#endif
+			while (x < cols && row[x] <= t)
+				x++;
+			if (x >= cols)
+				break;
+
+			Run run;
+			run.y = y;
+			run.x0 = x;
+			run.parent = (int)runs_.size();
+			run.peak = 0;
+			int64_t w = 0, wx = 0, wxx = 0;
+			while (x < cols && row[x] > t) {
+				const int v = row[x];
+				const int64_t vx = (int64_t)(v - t) * x;
+				w += v - t;
+				wx += vx;
+				wxx += vx * x;
+				run.peak = std::max(run.peak, (uint8_t)v);
+				x++;
+			}
+			run.w = w;
+			run.wx = wx;
+			run.wxx = wxx;
+			run.x1 = x;
+			runs_.push_back(run);
+		}
+	}
+
+	// merges runs of the current row with 8-connected runs of the previous one
+	void Connect(int prevBegin, int prevEnd, int begin, int end) {
+		int p = prevBegin;
+		for (int c = begin; c < end; c++) {
+			const Run& cur = runs_[c];
+			// previous runs ending left of the 8-neighbourhood can't touch this or later runs
+			while (p < prevEnd && runs_[p].x1 < cur.x0)
+				p++;
+			for (int q = p; q < prevEnd && runs_[q].x0 <= cur.x1; q++) {
+				Union(q, c);
+			}
+		}
+	}
+
+	int Find(int i) {
+		while (runs_[i].parent != i) {
+			runs_[i].parent = runs_[runs_[i].parent].parent;
+			i = runs_[i].parent;
+		}
+		return i;
+	}
+
+	void Union(int a, int b) {
+		a = Find(a);
+		b = Find(b);
+		if (a == b) return;
+		// the older run stays root, so roots come in scan order
+		if (a < b) runs_[b].parent = a;
+		else runs_[a].parent = b;
+	}
+
+	void Collect() {
+		acc_.resize(runs_.size());
+		for (size_t i = 0; i < runs_.size(); i++) {
+			const Run& run = runs_[i];
+			const int root = Find((int)i);
+			Acc& a = acc_[root];
+			if (root == (int)i) {
+				a = Acc();
+				a.minX = run.x0;
+				a.maxX = run.x1 - 1;
+				a.minY = a.maxY = run.y;
+			}
+
+			a.area += run.x1 - run.x0;
+			a.w += run.w;
+			a.wx += run.wx;
+			a.wy += run.w * run.y;
+			a.wxx += run.wxx;
+			a.wyy += run.w * run.y * run.y;
+			a.wxy += run.wx * run.y;
+			a.minX = std::min(a.minX, run.x0);
+			a.maxX = std::max(a.maxX, run.x1 - 1);
+			a.maxY = std::max(a.maxY, run.y);
+			a.peak = std::max(a.peak, run.peak);
+		}
+
+		for (size_t i = 0; i < runs_.size(); i++) {
+			if (runs_[i].parent != (int)i) continue;
+			const Acc& a = acc_[i];
+			if (a.area < minArea_ || a.area > maxArea_) continue;
+
+			const double w = (double)a.w;
+			const double cx = a.wx / w;
+			const double cy = a.wy / w;
+
+			Blob blob;
+			blob.cx = (float)(cx + 0.5);
+			blob.cy = (float)(cy + 0.5);
+			blob.mxx = (float)(a.wxx / w - cx * cx);
+			blob.myy = (float)(a.wyy / w - cy * cy);
+			blob.mxy = (float)(a.wxy / w - cx * cy);
+			blob.angle = 0.5f * atan2f(2 * blob.mxy, blob.mxx - blob.myy);
+			blob.area = a.area;
+			blob.bbox = cv::Rect(a.minX, a.minY, a.maxX - a.minX + 1, a.maxY - a.minY + 1);
+			blob.peak = a.peak;
+			blobs_.push_back(blob);
+		}
+	}
+
+	struct Acc {
+		int area = 0;
+		int64_t w = 0, wx = 0, wy = 0, wxx = 0, wyy = 0, wxy = 0;
+		int minX = 0, minY = 0, maxX = 0, maxY = 0;
+		uint8_t peak = 0;
+	};
+
+	int threshold_;
+	int minArea_;
+	int maxArea_;
+	bool stale_;	// blobs_ no longer match the parameters, the next detection scans everything
+
+	std::vector<Run> runs_;
+	std::vector<Acc> acc_;
+	std::vector<Blob> blobs_;
+	std::vector<Blob> kept_;
+	std::vector<uint8_t> scan_;
+	std::vector<int> stack_;
+};
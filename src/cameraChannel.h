@@ -0,0 +1,703 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Everything the UI can change while the tracker runs. Published as one
+// versioned block; each stage applies only the fields it owns.
+struct TrackerParams {
+	int exposure = 55;
+	int threshold = 240;
+	int minAreaRadius = 10;
+	int maxAreaRadius = 50;
+	int persistence = 15;	// wait for half a second before forgetting something
+	float maxDistance = 32;	// an object can move up to 32 pixels per frame
+	float minCutoff = 1;	// One-Euro filter, see FingerFollowers::setFilter
+	float beta = 0.05f;
+	float predictionOffset = 0;	// seconds on top of the measured pipeline latency, e.g. display lag
+	float maxPrediction = 0.05f;	// seconds, 0 turns prediction off
+	float gamma = 10;
+	int blurRadius = 4;	// 0..4, a 9x9 blur at 4
+	int backgroundRate = 0;	// learns 1/2^n of the difference per update, 0 turns subtraction off
+	int backgroundInterval = 4;	// frames between background updates
+	float changeThreshold = 0;	// mean gray level change that makes a tile be processed again, 0 processes every frame whole
+	float mergeDistance = 8;	// table pixels within which detections from two cameras are one finger
+	float alignWindow = 0.004f;	// seconds the tracker waits for the other cameras once one delivered
+};
+
+// Image sizes, fixed before the cameras start. Every size derives from the
+// camera's own resolution.
+struct TrackerResolution {
+	int processScale = 2;	// camera pixels per tracker pixel, a 640x480 camera is tracked at 320x240
+	int pyramidLevels = 0;	// detect at 1/2^levels of the tracker size, then refine every finger at full size
+	int refineMargin = 4;	// tracker pixels around a coarse detection that are refined with it
+};
+
+/*
+ Checkpoints a frame passes on its way through the pipeline. Each stage is
+ measured from the previous checkpoint, queueing included, so the stages
+ add up to STAGE_TOTAL (camera -> TUIO commit). Warp, background
+ subtraction, blur and gamma are a single fused pass and share
+ STAGE_PREPROCESS; with a change threshold, DETECT only covers the tiles
+ that pass recomputed. GRAB to DETECT run per camera, with several cameras
+ the newest frame of a round is measured and TRACK includes waiting for
+ the others. Commit is the hand-off to
+ the TUIO senders, the network is not part of the pipeline.
+*/
+enum LatencyStage {
+	STAGE_GRAB,
+	STAGE_PREPROCESS,
+	STAGE_DETECT,
+	STAGE_TRACK,
+	STAGE_COMMIT,
+	STAGE_TOTAL,
+	STAGE_COUNT
+};
+
+// one camera frame on its way to the tracker; handles into the camera pool and the channel's gray pool, nothing is copied
+struct ChannelFrame {
+	uint64_t timestamp;	// camera timestamp of raw, in ofGetElapsedTimeMicros()
+	uint64_t sequence;	// camera sequence number of raw
+	uint64_t stamps[STAGE_TRACK];	// GRAB, PREPROCESS and DETECT
+	FrameRef raw;
+	FrameRef gray;
+	bool detected;	// false when gray could not be allocated and blobs is empty for that reason
+	std::vector<Blob> blobs;	// in table pixels
+};
+
+/*
+ One camera's part of the pipeline: capture on one thread, then warp,
+ background, blur and blob detection on another, so every camera gets
+ cores of its own. Each camera has its own calibration, mapping it onto a
+ procSize image placed at offset on the table the tracker works on;
+ detections leave through Detected() in table pixels and come back with
+ Release().
+
+ With pyramid levels the whole frame is only blurred and detected at the
+ coarse size, each coarse pixel averaging its square of the full-size
+ warp so narrow fingertips are not sampled away. Around every coarse
+ blob a window of the full size map is then processed again, against the
+ coarse background, and detected once more for centroid and area; the
+ blur and detection at full resolution scale with the fingers, not with
+ the image.
+*/
+class CameraChannel
+{
+public:
+	enum { FRAME_COUNT = 4 };
+	typedef SpscRing<ChannelFrame*, FRAME_COUNT> FrameRing;
+
+	explicit CameraChannel(cv::Point offset)
+		: pm_(cv::Mat::eye(3, 3, CV_32F)),
+		cameraSize_(640, 480),
+		offset_(offset),
+		calibrated_(false),
+		isCalibMode_(false),
+		camera_(NULL),
+		pickOffset_(ofVec2f(0, 0)),
+		picked_(-1),
+		resetBackground_(false),
+		params_(NULL),
+		detectedSignal_(NULL),
+		running_(false),
+		droppedFrames_(0),
+		debugContours_(false)
+	{
+		contourFinder_ = std::make_unique<ofxCv::ContourFinder>();
+		contourFinder_->setAutoThreshold(true);
+
+		photometric_.SetGamma(10);
+		refine_.SetGamma(10);
+		Resize();
+		reset_rect();
+	}
+
+	~CameraChannel() { Stop(); }
+
+	// Sizes everything after the camera's resolution; a calibration made
+	// before is kept. Only while the channel is stopped.
+	void StartCamera(MyCamBase* cam, const TrackerResolution& resolution) {
+		// nothing may still point into the old pools
+		ReleaseFrames();
+
+		camera_ = cam;
+		camera_->Start();
+
+		resolution_ = resolution;
+		cameraSize_ = cv::Size(camera_->GetWidth(), camera_->GetHeight());
+		Resize();
+		if (calibrated_)
+			SetPerspective(pts_src);
+		else
+			reset_rect();
+
+		// one gray image per pipeline frame plus the three display buffers
+		grayPool_.Allocate(detectSize_.width, detectSize_.height, CV_8UC1, FRAME_COUNT + 3);
+	}
+
+	void StopCamera() {
+		if (camera_ != NULL)
+			camera_->Stop();
+	}
+
+	MyCamBase* Camera() const { return camera_; }
+
+	// tracker thread; params and detected outlive the channel's threads
+	void Start(const ParamBlock<TrackerParams>* params, RingSignal* detected) {
+		params_ = params;
+		detectedSignal_ = detected;
+		cameraApplied_ = detectApplied_ = false;
+		cameraVersion_ = preprocessVersion_ = detectVersion_ = 0;
+
+		// IR cameras deliver gray directly; on colour input the green channel
+		// is the closest single stand-in for luminance
+		photometric_.SetChannel((camera_->GetPixelFormat() == MyCamBase::GRAY8) ? 0 : 1);
+		refine_.SetChannel((camera_->GetPixelFormat() == MyCamBase::GRAY8) ? 0 : 1);
+
+		for (auto& frame : frames_) {
+			freeFrames_.Push(&frame);
+		}
+
+		running_ = true;
+		capture_ = std::thread(&CameraChannel::CaptureStage, this);
+		preprocess_ = std::thread(&CameraChannel::PreprocessStage, this);
+	}
+
+	// tracker thread, after the tracker handed back every frame it held
+	void Stop() {
+		if (!running_) return;
+		running_ = false;
+		freeFrames_.Wake();
+		capturedFrames_.Wake();
+		capture_.join();
+		preprocess_.join();
+		ReleaseFrames();
+	}
+
+	// tracker side of the detection queue
+	FrameRing& Detected() { return detectedFrames_; }
+
+	void Release(ChannelFrame* frame) {
+		frame->raw.Release();
+		frame->gray.Release();
+		freeFrames_.Push(frame);
+	}
+
+	cv::Point Offset() const { return offset_; }
+	// the calibration's space
+	cv::Size CameraSize() const { return cameraSize_; }
+	// tracker pixels, what detections are measured in
+	cv::Size ProcSize() const { return procSize_; }
+	// the displayed image over ProcSize() in x and y, below 1 with pyramid levels
+	cv::Point2f DisplayScale() const {
+		return cv::Point2f((float)detectSize_.width / procSize_.width, (float)detectSize_.height / procSize_.height);
+	}
+
+	// camera frames skipped because every pipeline frame was still in flight
+	uint64_t GetDroppedFrames() const { return droppedFrames_; }
+
+	// render thread, see FingerTracker::GetImage
+	bool GetImage(ofImage& image) {
+		if (!resultImg_.Consume())
+			return false;
+
+		FrameRef& frame = resultImg_.Front();
+		if (!frame)
+			return false;
+
+		ofxCv::toOf(frame->image, image);
+		return true;
+	}
+
+	// any thread, the background is relearned from the next frame
+	void ResetBackground() { resetBackground_ = true; }
+
+	void SetDebugContours(bool enabled) { debugContours_ = enabled; }
+
+	void DrawContours() {
+		if (!debugContours_) return;
+		std::lock_guard<std::mutex> guard(contourMutex_);
+		ofSetColor(255, 0, 0);
+		contourFinder_->draw();
+	}
+
+	ofxCv::ContourFinder* ContourFinder() {
+		return contourFinder_.get();
+	}
+
+	void EnterCalibMode() {
+		isCalibMode_ = true;
+		picked_ = -1;
+	}
+
+	void SetCalib() {
+		SetPerspective(pts_src);
+	}
+
+	void ExitCalibMode() {
+		isCalibMode_ = false;
+		picked_ = -1;
+	}
+	bool IsCalibMode() { return isCalibMode_; }
+
+	void MoveClosestPoint(int x, int y) {
+		if (picked_ > -1) {
+			pts_src[picked_] = ofVec2f(x, y) + pickOffset_;
+		}
+	}
+
+	void PickClosestPoint(int x, int y) {
+		auto cls = 9999999.9;
+		for (size_t i = 0; i < 4; i++)
+		{
+			auto v = pts_src[i] - ofVec2f(x, y);
+			auto d = v.length();
+			if (cls > d) {
+				picked_ = i;
+				cls = d;
+				pickOffset_ = v;
+			}
+		}
+	}
+
+	void reset_rect() {
+		const float w = (float)cameraSize_.width, h = (float)cameraSize_.height;
+		std::vector<ofVec2f> rect;
+		rect.push_back(ofVec2f(0, 0));
+		rect.push_back(ofVec2f(w - 1, 0));
+		rect.push_back(ofVec2f(w - 1, h - 1));
+		rect.push_back(ofVec2f(0, h - 1));
+		SetPerspective(rect);
+		calibrated_ = false;
+	}
+
+	void DrawSrcRect() {
+		if (isCalibMode_) {
+			ofNoFill();
+			ofSetColor(255, 0, 0);
+			ofDrawCircle(pts_src[0], 10);
+			ofDrawBitmapString("0", pts_src[0]);
+			ofDrawLine(pts_src[0], pts_src[1]);
+
+			ofSetColor(0, 255, 0);
+			ofDrawCircle(pts_src[1], 10);
+			ofDrawBitmapString("1", pts_src[1]);
+			ofDrawLine(pts_src[1], pts_src[2]);
+
+			ofSetColor(0, 0, 255);
+			ofDrawCircle(pts_src[2], 10);
+			ofDrawBitmapString("2", pts_src[2]);
+			ofDrawLine(pts_src[2], pts_src[3]);
+
+			ofSetColor(255, 255, 0);
+			ofDrawCircle(pts_src[3], 10);
+			ofDrawBitmapString("3", pts_src[3]);
+			ofDrawLine(pts_src[3], pts_src[0]);
+			ofFill();
+		}
+	}
+
+	/*
+	 (0,0)          (w-1,0)
+	    0--------- 1
+	    |          |
+	    |          |
+	    3----------2
+	 (0,h-1)        (w-1,h-1)
+	 in camera pixels, w x h being the camera's resolution
+	*/
+	void SetPerspective(std::vector<ofVec2f> rect) {
+		if (rect.size() != 4) return;
+		calibrated_ = true;
+
+		pts_src.clear();
+		std::vector<cv::Point2f> src;
+		for (size_t i = 0; i < 4; i++)
+		{
+			pts_src.push_back(rect[i]);
+			src.push_back(cv::Point2f(rect[i].x, rect[i].y));
+		}
+
+		const float w = (float)cameraSize_.width, h = (float)cameraSize_.height;
+		std::vector<cv::Point2f> dst;
+		dst.push_back(cv::Point2f(0, 0));
+		dst.push_back(cv::Point2f(w - 1, 0));
+		dst.push_back(cv::Point2f(w - 1, h - 1));
+		dst.push_back(cv::Point2f(0, h - 1));
+
+		cv::Mat pm = cv::getPerspectiveTransform(src, dst);
+
+		cv::Mat mapXY = BuildRemap(pm, procSize_);
+
+		std::lock_guard<std::mutex> guard(mapMutex_);
+		pm_ = pm;
+		mapXY_ = mapXY;
+	}
+
+	cv::Mat GetPerspective() {
+		std::lock_guard<std::mutex> guard(mapMutex_);
+		return pm_.clone();
+	}
+
+	/*
+	 Folds the homography and the camera size -> size downscale into a single
+	 nearest-neighbour lookup: output pixel (u, v) reads the source pixel that
+	 warpPerspective + resize(INTER_NEAREST) would have picked for it.
+	*/
+	cv::Mat BuildRemap(const cv::Mat& pm, cv::Size size) {
+		cv::Mat inv = pm.inv();
+		const double* h = inv.ptr<double>(0);
+		const float sx = (float)cameraSize_.width / size.width;
+		const float sy = (float)cameraSize_.height / size.height;
+
+		cv::Mat mapX(size, CV_32FC1);
+		cv::Mat mapY(size, CV_32FC1);
+		for (int v = 0; v < size.height; v++) {
+			float* mx = mapX.ptr<float>(v);
+			float* my = mapY.ptr<float>(v);
+			const double y = (int)(v * sy);
+			for (int u = 0; u < size.width; u++) {
+				const double x = (int)(u * sx);
+				const double w = h[6] * x + h[7] * y + h[8];
+				const double iw = (w != 0) ? 1.0 / w : 0.0;
+				mx[u] = (float)((h[0] * x + h[1] * y + h[2]) * iw);
+				my[u] = (float)((h[3] * x + h[4] * y + h[5]) * iw);
+			}
+		}
+
+		// integer source coordinates, read directly by PhotometricKernel
+		cv::Mat mapXY, unused;
+		cv::convertMaps(mapX, mapY, mapXY, unused, CV_16SC2, true);
+		return mapXY;
+	}
+
+	std::vector<ofVec2f> pts_src;
+
+private:
+	/*
+	 Drops every FrameRef the channel holds, into grayPool_ or the camera's
+	 pool, and leaves the rings empty so a restart can hand out every frame
+	 again. The threads must be stopped and GetImage() not running.
+	*/
+	void ReleaseFrames() {
+		ChannelFrame* frame;
+		while (freeFrames_.Pop(frame) || capturedFrames_.Pop(frame) || detectedFrames_.Pop(frame)) {
+		}
+		for (auto& f : frames_) {
+			f.raw.Release();
+			f.gray.Release();
+		}
+		resultImg_.Reset();
+	}
+
+	// with pyramid levels the tracker size is rounded up to whole coarse
+	// pixels, so both levels cover the same part of the camera image
+	void Resize() {
+		const int scale = std::max(resolution_.processScale, 1);
+		const int levels = std::min(std::max(resolution_.pyramidLevels, 0), 4);
+		const int n = 1 << levels;
+		procSize_ = cv::Size((std::max(cameraSize_.width / scale, 1) + n - 1) / n * n,
+			(std::max(cameraSize_.height / scale, 1) + n - 1) / n * n);
+		detectSize_ = cv::Size(procSize_.width >> levels, procSize_.height >> levels);
+		photometric_.SetReduceLevels(levels);
+		if (detectSize_ != procSize_) {
+			refineBuffer_.create(procSize_, CV_8UC1);
+			refineBackground_.create(procSize_, CV_16SC1);
+		}
+	}
+
+	void CaptureStage()
+	{
+		ChannelFrame* frame = NULL;
+		while (running_) {
+			ApplyCameraParams();
+
+			// recorded input waits for a free pipeline frame instead of being dropped
+			if (frame == NULL && !camera_->IsLive()) {
+				if (!freeFrames_.WaitPop(frame, std::chrono::milliseconds(100)))
+					continue;
+			}
+
+			// sleep until the backend signals a frame, the timeout only bounds shutdown
+			if (!camera_->WaitFrame(std::chrono::milliseconds(100)))
+				continue;
+
+			if (frame == NULL)
+				freeFrames_.Pop(frame);
+
+			camera_->Grab([this, &frame](FrameRef img) {
+				// every frame is still in flight, drop this one rather than stall the camera
+				if (frame == NULL) {
+					droppedFrames_++;
+					return;
+				}
+
+				frame->timestamp = img->timestamp;
+				frame->sequence = img->sequence;
+				frame->stamps[STAGE_GRAB] = ofGetElapsedTimeMicros();
+				frame->raw = std::move(img);
+				capturedFrames_.Push(frame);
+				frame = NULL;
+				});
+		}
+	}
+
+	void PreprocessStage()
+	{
+		ChannelFrame* frame;
+		while (running_) {
+			if (!capturedFrames_.WaitPop(frame, std::chrono::milliseconds(100)))
+				continue;
+
+			// the map is swapped as a whole by SetPerspective, so holding
+			// the header is enough to keep it consistent for this frame
+			cv::Mat mapXY;
+			{
+				std::lock_guard<std::mutex> guard(mapMutex_);
+				mapXY = mapXY_;
+			}
+
+			ApplyPreprocessParams();
+			if (resetBackground_.exchange(false))
+				photometric_.ResetBackground();
+
+			// warp + downscale (box-reduced to the coarse level), channel pick,
+			// background, blur and gamma in one pass
+			frame->gray = grayPool_.Acquire();
+			if (frame->gray)
+				photometric_.Process(frame->raw->image, mapXY, frame->gray->image, &bg_);
+			frame->stamps[STAGE_PREPROCESS] = ofGetElapsedTimeMicros();
+
+			// the display just shares the handle, publishing never blocks
+			resultImg_.Back() = isCalibMode_ ? frame->raw : frame->gray;
+			resultImg_.Publish();
+
+			ApplyDetectParams();
+			frame->detected = (bool)frame->gray;
+			frame->blobs.clear();
+			if (frame->gray) {
+				// static tiles keep last frame's blobs
+				if (photometric_.IsTiled())
+					blobDetector_.Detect(frame->gray->image, photometric_.ChangedTiles(), photometric_.TileMax(), PhotometricKernel::TILE);
+				else
+					blobDetector_.Detect(frame->gray->image);
+				// fingers found now are not learned into the background next frame
+				FreezeBlobs(blobDetector_.Blobs());
+
+				const std::vector<Blob>& blobs = (detectSize_ == procSize_)
+					? blobDetector_.Blobs()
+					: Refine(frame->raw->image, mapXY, blobDetector_.Blobs());
+				for (Blob blob : blobs) {
+					blob.cx += offset_.x;
+					blob.cy += offset_.y;
+					blob.bbox.x += offset_.x;
+					blob.bbox.y += offset_.y;
+					frame->blobs.push_back(blob);
+				}
+			}
+			frame->raw.Release();
+			frame->stamps[STAGE_DETECT] = ofGetElapsedTimeMicros();
+
+			// contours are only traced for the overlay, after the frame is on its way
+			FrameRef gray = debugContours_ ? frame->gray : FrameRef();
+			detectedFrames_.Push(frame);
+			detectedSignal_->Notify();
+
+			if (gray) {
+				std::lock_guard<std::mutex> guard(contourMutex_);
+				contourFinder_->findContours(gray->image);
+			}
+		}
+	}
+
+	/*
+	 Coarse blobs -> blobs in tracker pixels. Each blob's box is scaled up
+	 and grown by the margin and the blur radius; overlapping windows are
+	 joined so every finger is found exactly once. The windows are ROIs of
+	 the same map the coarse level was reduced from.
+	*/
+	const std::vector<Blob>& Refine(const cv::Mat& raw, const cv::Mat& mapXY, const std::vector<Blob>& coarse) {
+		const float sx = (float)procSize_.width / detectSize_.width;
+		const float sy = (float)procSize_.height / detectSize_.height;
+		const int margin = resolution_.refineMargin + PhotometricKernel::RADIUS;
+		const cv::Rect bounds(0, 0, procSize_.width, procSize_.height);
+		windows_.clear();
+		for (const auto& blob : coarse) {
+			const int x0 = (int)floorf(blob.bbox.x * sx) - margin;
+			const int y0 = (int)floorf(blob.bbox.y * sy) - margin;
+			const int x1 = (int)ceilf((blob.bbox.x + blob.bbox.width) * sx) + margin;
+			const int y1 = (int)ceilf((blob.bbox.y + blob.bbox.height) * sy) + margin;
+			const cv::Rect window = cv::Rect(x0, y0, x1 - x0, y1 - y0) & bounds;
+			if (window.area() > 0)
+				windows_.push_back(window);
+		}
+		for (size_t i = 0; i < windows_.size();) {
+			size_t j = i + 1;
+			while (j < windows_.size() && (windows_[i] & windows_[j]).area() == 0)
+				j++;
+			if (j == windows_.size()) {
+				i++;
+				continue;
+			}
+			// the grown window may now reach one already passed
+			windows_[i] |= windows_[j];
+			windows_.erase(windows_.begin() + j);
+			i = 0;
+		}
+
+		refined_.clear();
+		const bool subtract = preprocessParams_.backgroundRate > 0 && !bg_.empty();
+		for (const auto& window : windows_) {
+			const cv::Rect size(0, 0, window.width, window.height);
+			cv::Mat gray = refineBuffer_(size);
+			cv::Mat background = refineBackground_(size);
+			if (subtract)
+				UpsampleBackground(window, sx, sy, background);
+			refine_.Process(raw, mapXY(window), gray, subtract ? &background : NULL, false);
+
+			for (Blob blob : refineDetector_.Detect(gray)) {
+				blob.cx += window.x;
+				blob.cy += window.y;
+				blob.bbox.x += window.x;
+				blob.bbox.y += window.y;
+				refined_.push_back(blob);
+			}
+		}
+		return refined_;
+	}
+
+	// nearest coarse background value for every pixel of window
+	void UpsampleBackground(const cv::Rect& window, float sx, float sy, cv::Mat& background) const {
+		for (int v = 0; v < window.height; v++) {
+			const int16_t* in = bg_.ptr<int16_t>(std::min((int)((window.y + v) / sy), bg_.rows - 1));
+			int16_t* out = background.ptr<int16_t>(v);
+			for (int u = 0; u < window.width; u++)
+				out[u] = in[std::min((int)((window.x + u) / sx), bg_.cols - 1)];
+		}
+	}
+
+	// capture stage, the only thread that talks to the camera
+	void ApplyCameraParams() {
+		TrackerParams params = cameraParams_;
+		if (!params_->Read(params, cameraVersion_))
+			return;
+
+		if (params.exposure != cameraParams_.exposure || !cameraApplied_)
+			camera_->SetExposure(params.exposure);
+
+		cameraParams_ = params;
+		cameraApplied_ = true;
+	}
+
+	// preprocess stage, the kernel skips whatever did not change
+	void ApplyPreprocessParams() {
+		if (!params_->Read(preprocessParams_, preprocessVersion_))
+			return;
+		photometric_.SetGamma(preprocessParams_.gamma);
+		photometric_.SetBlurRadius(preprocessParams_.blurRadius);
+		photometric_.SetBackgroundRate(preprocessParams_.backgroundRate, preprocessParams_.backgroundInterval);
+		photometric_.SetChangeThreshold(preprocessParams_.changeThreshold);
+		refine_.SetGamma(preprocessParams_.gamma);
+		refine_.SetBlurRadius(preprocessParams_.blurRadius);
+		refine_.SetBackgroundRate(preprocessParams_.backgroundRate, preprocessParams_.backgroundInterval);
+	}
+
+	// preprocess stage, right before detection
+	void ApplyDetectParams() {
+		TrackerParams params = detectParams_;
+		if (!params_->Read(params, detectVersion_))
+			return;
+
+		if (params.threshold != detectParams_.threshold
+			|| params.minAreaRadius != detectParams_.minAreaRadius
+			|| params.maxAreaRadius != detectParams_.maxAreaRadius
+			|| !detectApplied_) {
+			// radii are in tracker pixels, the coarse image is smaller
+			const cv::Point2f display = DisplayScale();
+			const float scale = sqrtf(display.x * display.y);
+			blobDetector_.SetThreshold(params.threshold);
+			blobDetector_.SetMinAreaRadius(params.minAreaRadius * scale);
+			blobDetector_.SetMaxAreaRadius(params.maxAreaRadius * scale);
+			refineDetector_.SetThreshold(params.threshold);
+			refineDetector_.SetMinAreaRadius(params.minAreaRadius);
+			refineDetector_.SetMaxAreaRadius(params.maxAreaRadius);
+
+			std::lock_guard<std::mutex> guard(contourMutex_);
+			contourFinder_->setThreshold(params.threshold);
+			contourFinder_->setMinAreaRadius(params.minAreaRadius * scale);
+			contourFinder_->setMaxAreaRadius(params.maxAreaRadius * scale);
+		}
+
+		detectParams_ = params;
+		detectApplied_ = true;
+	}
+
+	// blob boxes grown by half their size, the blur spreads a finger further than its threshold area
+	void FreezeBlobs(const std::vector<Blob>& blobs) {
+		freezeRects_.clear();
+		for (const auto& blob : blobs) {
+			const int mx = blob.bbox.width / 2 + PhotometricKernel::RADIUS;
+			const int my = blob.bbox.height / 2 + PhotometricKernel::RADIUS;
+			freezeRects_.push_back(cv::Rect(blob.bbox.x - mx, blob.bbox.y - my, blob.bbox.width + 2 * mx, blob.bbox.height + 2 * my));
+		}
+		photometric_.SetBackgroundFreeze(freezeRects_);
+	}
+
+	cv::Mat pm_;
+	cv::Mat mapXY_;	// camera -> procSize_, reduced to detectSize_ by the kernel
+	std::mutex mapMutex_;	// pm_ and mapXY_ against the preprocess stage
+	TrackerResolution resolution_;
+	cv::Size cameraSize_;
+	cv::Size procSize_;
+	cv::Size detectSize_;
+	cv::Point offset_;
+	bool calibrated_;	// pts_src was set, not just the whole camera image
+	TripleBuffer<FrameRef> resultImg_;
+	std::atomic<bool> isCalibMode_;	// set from the UI thread, read by the preprocess stage
+	MyCamBase* camera_;
+	ofVec2f pickOffset_;
+	int picked_;
+
+	cv::Mat bg_;	// background model, owned by the preprocess stage
+	PhotometricKernel photometric_;
+	std::vector<cv::Rect> freezeRects_;	// preprocess stage only
+	std::atomic<bool> resetBackground_;
+	BlobDetector blobDetector_;
+	std::unique_ptr<ofxCv::ContourFinder> contourFinder_;
+	std::mutex contourMutex_;	// contourFinder_ against draw()
+
+	// pyramid refinement, preprocess stage only
+	PhotometricKernel refine_;
+	BlobDetector refineDetector_;
+	cv::Mat refineBuffer_;
+	cv::Mat refineBackground_;
+	std::vector<cv::Rect> windows_;
+	std::vector<Blob> refined_;
+
+	const ParamBlock<TrackerParams>* params_;
+	TrackerParams cameraParams_;
+	TrackerParams preprocessParams_;
+	TrackerParams detectParams_;
+	uint64_t cameraVersion_ = 0;
+	uint64_t preprocessVersion_ = 0;
+	uint64_t detectVersion_ = 0;
+	bool cameraApplied_ = false;
+	bool detectApplied_ = false;
+
+	FramePool grayPool_;
+	ChannelFrame frames_[FRAME_COUNT];
+	FrameRing freeFrames_;
+	FrameRing capturedFrames_;
+	FrameRing detectedFrames_;
+	RingSignal* detectedSignal_;
+	std::thread capture_;
+	std::thread preprocess_;
+	std::atomic<bool> running_;
+	std::atomic<uint64_t> droppedFrames_;
+	std::atomic<bool> debugContours_;
+};
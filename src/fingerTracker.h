@@ -1,397 +1,989 @@
-class FingerFollower : public ofxCv::RectFollower {
-protected:
-	ofColor color;
-	float startedDying_;
-	float startedNasent_;
-	float dyingTime_;
-	float nasentTime_;
-	ofPolyline trail_;
+// Fixed-capacity trail, the oldest point is overwritten once it is full.
+template <int N>
+class TrailRing
+{
+public:
+	TrailRing() : head_(0), count_(0) {}
+
+	void clear() {
+		head_ = 0;
+		count_ = 0;
+	}
+
+	void push(const ofVec2f& p) {
+		if (count_ < N) {
+			points_[(head_ + count_) % N] = p;
+			count_++;
+		}
+		else {
+			points_[head_] = p;
+			head_ = (head_ + 1) % N;
+		}
+	}
 
+	int size() const { return count_; }
+
+	// oldest first
+	const ofVec2f& operator[](int i) const { return points_[(head_ + i) % N]; }
+
+	void draw() const {
+		if (count_ < 2) return;
+		ofBeginShape();
+		for (int i = 0; i < count_; i++) {
+			const ofVec2f& p = (*this)[i];
+			ofVertex(p.x, p.y);
+		}
+		ofEndShape(false);
+	}
+
+private:
+	ofVec2f points_[N];
+	int head_;
+	int count_;
+};
+
+/*
+ Follower state for every tracked finger, keyed by tracker label.
+
+ The per-frame state lives in parallel arrays so the track stage, the
+ snapshot for the output stage and draw() are plain linear scans with no
+ copies. Trail and colour are only touched for drawing and sit in a
+ separate cold array. Indices stay valid until compact(), which the
+ track stage calls once per frame after the snapshot is taken. find()
+ scans the dense label array; with a few dozen fingers at most that beats
+ a hash map and never allocates.
+*/
+class FingerFollowers
+{
 public:
-	ofVec3f cur, smooth;
-	enum { NASENT, BORN, ALIVE, DEAD } state_;
+	enum State { NASENT, BORN, ALIVE, DEAD };
 
-	FingerFollower() :
-		startedDying_(0),
-		startedNasent_(0),
+	enum { TRAIL_LENGTH = 30 };
+
+	FingerFollowers() :
+		trailEnabled_(true),
 		dyingTime_(1),
-		nasentTime_(0.5) {}
+		nasentTime_(0.5),
+		minCutoff_(1),
+		beta_(0.05f),
+		derivateCutoff_(1) {}
+
+	// trails are only needed for the debug overlay, headless runs can skip them
+	void setTrailEnabled(bool enabled) {
+		trailEnabled_ = enabled;
+		if (!enabled) {
+			for (auto& cold : cold_) cold.trail.clear();
+		}
+	}
+
+	/*
+	 One-Euro filter: the cutoff frequency rises with speed, so a resting
+	 finger is smoothed heavily (minCutoff, Hz) and a fast drag barely lags
+	 (beta scales the cutoff per pixel/s).
+	*/
+	void setFilter(float minCutoff, float beta) {
+		minCutoff_ = minCutoff;
+		beta_ = beta;
+	}
 
-	void setup(const cv::Rect& track) {
-		startedNasent_ = ofGetElapsedTimef();
+	// hot state, index i describes one follower
+	std::vector<unsigned int> label;
+	std::vector<uint8_t> state;
+	std::vector<ofVec2f> cur;
+	std::vector<ofVec2f> smooth;
+	std::vector<ofVec2f> vel;	// pixels per second
+	// capture times in microseconds; a float of seconds since start loses
+	// the frame spacing after a few hours of uptime
+	std::vector<uint64_t> updated;	// time of the last filter step
+	std::vector<uint64_t> startedNasent;
+	std::vector<uint64_t> startedDying;
+
+	size_t size() const { return label.size(); }
+
+	int find(unsigned int l) const {
+		auto it = std::find(label.begin(), label.end(), l);
+		return (it != label.end()) ? (int)(it - label.begin()) : -1;
+	}
 
-		smooth = ofxCv::toOf(track).getCenter();
-		state_ = NASENT;
-		trail_.clear();
+	void add(unsigned int l, const Blob& blob, uint64_t now) {
+		ofVec2f center(blob.cx, blob.cy);
+		label.push_back(l);
+		state.push_back(NASENT);
+		cur.push_back(center);
+		smooth.push_back(center);
+		vel.push_back(ofVec2f(0, 0));
+		updated.push_back(now);
+		startedNasent.push_back(now);
+		startedDying.push_back(0);
+
+		cold_.resize(label.size());
+		cold_.back().trail.clear();
 	}
 
-	void update(const cv::Rect track) {
-		if (state_ == BORN)
-			state_ = ALIVE;
+	void update(int i, const Blob& blob, uint64_t now) {
+		if (state[i] == BORN)
+			state[i] = ALIVE;
 
-		if (state_ == ALIVE) {
-			startedDying_ = 0;
+		// keep the filter warm while nasent, so a cursor is born where the finger is
+		cur[i].set(blob.cx, blob.cy);
+		filter(i, now);
 
-			cur = ofxCv::toOf(track).getCenter();
-			smooth.interpolate(cur, .5);
+		if (state[i] == ALIVE) {
+			startedDying[i] = 0;
 
-			trail_.addVertex(smooth);
-			if (trail_.size() > 30)
-				trail_.removeVertex(0);
+			if (trailEnabled_)
+				cold_[i].trail.push(smooth[i]);
 		}
-		else if (state_ == NASENT) {
-			float curTime = ofGetElapsedTimef();
-			if (curTime - startedNasent_ > nasentTime_) {
-				color.setHsb(ofRandom(0, 255), 255, 255);
-				state_ = BORN;
+		else if (state[i] == NASENT) {
+			if (Seconds(now - startedNasent[i]) > nasentTime_) {
+				cold_[i].color.setHsb(ofRandom(0, 255), 255, 255);
+				state[i] = BORN;
 			}
 		}
 	}
 
-	void kill() {
-		float curTime = ofGetElapsedTimef();
-		if (state_ == ALIVE) {
-			if (startedDying_ == 0) {
-				startedDying_ = curTime;
+	void kill(int i, uint64_t now) {
+		if (state[i] == ALIVE) {
+			if (startedDying[i] == 0) {
+				startedDying[i] = now;
+				// the finger lifted where it was last seen, don't extrapolate past it
+				vel[i].set(0, 0);
 			}
-			else if (curTime - startedDying_ > dyingTime_) {
-				//dead = true;
-				state_ = DEAD;
-				//trail_.clear();
+			else if (Seconds(now - startedDying[i]) > dyingTime_) {
+				state[i] = DEAD;
 			}
 		}
 		else {
-			//dead = true;
-			state_ = DEAD;
+			state[i] = DEAD;
 		}
 	}
-	
-	void terminate()
-	{
-		dead = true;
-		state_ = DEAD;
-		trail_.clear();
+
+	// a follower that started dying gets no more updates, keep its clock running
+	void tick(uint64_t now) {
+		for (size_t i = 0; i < label.size(); i++) {
+			if (state[i] == ALIVE && startedDying[i] != 0)
+				kill((int)i, now);
+		}
 	}
 
-	void draw() {
-		if (state_ != ALIVE) return;
+	// drops every DEAD follower, the order of the remaining ones may change
+	void compact() {
+		size_t n = label.size();
+		for (size_t i = 0; i < n;) {
+			if (state[i] != DEAD) {
+				i++;
+				continue;
+			}
+			n--;
+			if (i != n) {
+				label[i] = label[n];
+				state[i] = state[n];
+				cur[i] = cur[n];
+				smooth[i] = smooth[n];
+				vel[i] = vel[n];
+				updated[i] = updated[n];
+				startedNasent[i] = startedNasent[n];
+				startedDying[i] = startedDying[n];
+				std::swap(cold_[i], cold_[n]);
+			}
+		}
+		label.resize(n);
+		state.resize(n);
+		cur.resize(n);
+		smooth.resize(n);
+		vel.resize(n);
+		updated.resize(n);
+		startedNasent.resize(n);
+		startedDying.resize(n);
+		cold_.resize(n);
+	}
 
-		float curTime = ofGetElapsedTimef();
-		float age = curTime - nasentTime_;
+	void draw(int i, uint64_t now) const {
+		if (state[i] != ALIVE) return;
 
 		ofPushStyle();
 
 		float size = 16;
 		ofSetColor(0, 0, 255);
 
-		if (startedDying_) {
+		if (startedDying[i]) {
 			ofSetColor(ofColor::red);
-			size = ofMap(ofGetElapsedTimef() - startedDying_, 0, dyingTime_, size, 0, true);
+			const float dying = (now > startedDying[i]) ? Seconds(now - startedDying[i]) : 0;
+			size = ofMap(dying, 0, dyingTime_, size, 0, true);
 		}
 
 		ofNoFill();
-		auto label = this->getLabel();
-		ofSeedRandom(label << 24);
+		auto l = label[i];
+		ofSeedRandom(l << 24);
 		ofSetColor(ofColor::fromHsb(ofRandom(255), 255, 255));
 
-		ofDrawCircle(cur, size);
-		ofDrawBitmapString(ofToString(label), cur.x, cur.y);
+		const ofVec2f& c = cur[i];
+		ofDrawCircle(c, size);
+		ofDrawBitmapString(ofToString(l), c.x, c.y);
 
 		ofSetColor(0, 255, 255);
-		switch (state_)
+		switch (state[i])
 		{
-		case FingerFollower::NASENT:
-			ofDrawBitmapString("NASENT", cur.x, cur.y-10);
+		case NASENT:
+			ofDrawBitmapString("NASENT", c.x, c.y-10);
 			break;
-		case FingerFollower::BORN:
-			ofDrawBitmapString("BORN", cur.x, cur.y-10);
+		case BORN:
+			ofDrawBitmapString("BORN", c.x, c.y-10);
 			break;
-		case FingerFollower::ALIVE:
-			ofDrawBitmapString("ALIVE", cur.x, cur.y-10);
+		case ALIVE:
+			ofDrawBitmapString("ALIVE", c.x, c.y-10);
 			break;
-		case FingerFollower::DEAD:
-			ofDrawBitmapString("DEAD", cur.x, cur.y-10);
+		case DEAD:
+			ofDrawBitmapString("DEAD", c.x, c.y-10);
 			break;
 		default:
 			break;
 		}
 
-		trail_.draw();
+		cold_[i].trail.draw();
 		ofPopStyle();
 	}
+
+private:
+	void filter(int i, uint64_t now) {
+		if (now <= updated[i]) return;
+		const float dt = Seconds(now - updated[i]);
+		updated[i] = now;
+
+		const ofVec2f v = (cur[i] - smooth[i]) / dt;
+		vel[i] += (v - vel[i]) * alpha(dt, derivateCutoff_);
+
+		const float cutoff = minCutoff_ + beta_ * vel[i].length();
+		smooth[i] += (cur[i] - smooth[i]) * alpha(dt, cutoff);
+	}
+
+	static float Seconds(uint64_t micros) { return (float)micros * 1e-6f; }
+
+	static float alpha(float dt, float cutoff) {
+		const float tau = 1.0f / (TWO_PI * cutoff);
+		return 1.0f / (1.0f + tau / dt);
+	}
+
+	struct Cold {
+		ofColor color;
+		TrailRing<TRAIL_LENGTH> trail;
+	};
+	std::vector<Cold> cold_;
+
+	bool trailEnabled_;
+	float dyingTime_;
+	float nasentTime_;
+	float minCutoff_;
+	float beta_;
+	float derivateCutoff_;
 };
 
+// follower state as seen by the output stage
+struct TouchPoint {
+	int label;
+	int state;
+	ofVec2f pos;
+	ofVec2f vel;	// pixels per second
+};
+
+struct LatencyStats {
+	uint64_t p50, p99, max;	// microseconds
+	uint64_t count;
+};
+
+// one tracker step, built from a round of camera frames
+struct TrackerFrame {
+	uint64_t timestamp;	// camera timestamp of the newest frame in the round, in ofGetElapsedTimeMicros()
+	uint64_t sequence;	// camera sequence number of the first camera's frame, 0 if it had none in the round
+	uint64_t stamps[STAGE_TOTAL];	// ofGetElapsedTimeMicros() at each checkpoint
+	std::vector<TouchPoint> touches;
+};
 
 class FingerTracker : public ofThread
 {
 public:
 	FingerTracker()
-		: pm_(cv::Mat::eye(3, 3, CV_32F)),
-		isCalibMode_(false),
-		inputCamera_(NULL),
-		pickOffset_(ofVec2f(0, 0))
+		: selected_(0),
+		ringReportedCount_(0),
+		trailEnabled_(true),
+		stagesRunning_(false),
+		latency_(0)
 	{
-		tuioServer_ = std::make_unique<TUIO::TuioServer>();
-		contourFinder_ = std::make_unique<ofxCv::ContourFinder>();
-		tracker_ = std::make_unique<ofxCv::RectTrackerFollower<FingerFollower>>();
+		tracker_ = std::make_unique<SpatialTracker>();
+		ringTouches_.reserve(touchring::MAX_TOUCHES);
 
-		tuioServer_->setSourceName("ofTracker");
-		tuioServer_->enableObjectProfile(false);
-		tuioServer_->enableBlobProfile(false);
-		reset_rect();
+		// the first camera spans the table until more are added
+		AddChannel(cv::Point(0, 0));
 	}
 
 	~FingerTracker() {
 	}
 
-	void StartInputCamera(MyCamBase* cam)
+	/*
+	 Before startThread(). Adds a camera whose warped image sits at offset
+	 on the table, in tracker pixels; overlapping cameras see the same
+	 fingers, which the tracker merges. Returns the channel index.
+	*/
+	int AddChannel(cv::Point offset)
 	{
-		inputCamera_ = cam;
-		inputCamera_->Start();
+		channels_.push_back(std::make_unique<CameraChannel>(offset));
+		UpdateTable();
+		return (int)channels_.size() - 1;
 	}
 
-	void StopInputCamera()
+	// before the cameras start, sizes follow from each camera's resolution
+	void SetResolution(const TrackerResolution& resolution) { resolution_ = resolution; }
+
+	size_t ChannelCount() const { return channels_.size(); }
+	CameraChannel& Channel(size_t i) { return *channels_[i]; }
+
+	// the camera shown by GetImage() and draw(), and the one being calibrated
+	void SelectChannel(size_t i)
 	{
-		if (inputCamera_ != NULL)
-			inputCamera_->Stop();
+		if (i >= channels_.size() || i == selected_) return;
+		const bool calib = Selected().IsCalibMode();
+		Selected().ExitCalibMode();
+		selected_ = i;
+		if (calib)
+			Selected().EnterCalibMode();
 	}
+	size_t SelectedChannel() const { return selected_; }
 
-	void GetImage(ofImage& image) { 
-		lock();
-		ofxCv::toOf(resultImg_, image);
-		unlock();
+	void StartInputCamera(MyCamBase* cam, size_t channel = 0)
+	{
+		channels_[channel]->StartCamera(cam, resolution_);
+		UpdateTable();
 	}
 
-	void Gamma(cv::Mat src, cv::Mat dst, double gamma)
+	void StopInputCamera()
 	{
-		uchar LUT[256];
-		for (int i = 0; i < 256; i++) {
-			LUT[i] = (int)(pow((double)i / 255.0, gamma) * 255.0);
+		for (auto& channel : channels_)
+			channel->StopCamera();
+	}
+
+	// before startThread(), the senders run while the tracker does
+	void SetTuioOutput(const TuioOutputConfig& config) { tuioConfig_ = config; }
+
+	// Before startThread(). Publishes every frame's touches to the shared memory
+	// ring name (see touchRing.h); an empty name closes it.
+	bool SetSharedTouchOutput(const std::string& name) {
+		if (name.empty()) {
+			touchRing_.Close();
+			return true;
 		}
+		// ring timestamps are ofGetElapsedTimeMicros(), readers get them as steady_clock
+		const uint64_t now = std::chrono::duration_cast<std::chrono::microseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()).count();
+		return touchRing_.Open(name, now - ofGetElapsedTimeMicros());
+	}
 
-		cv::Mat lut_mat = cv::Mat(1, 256, CV_8UC1, LUT);
+	// per destination, while the tracker runs
+	std::vector<TuioDestinationStats> GetTuioStats() const { return tuioSender_.GetStats(); }
 
-		cv::LUT(src, lut_mat, dst);
+	// camera frames skipped because every pipeline frame was still in flight, all cameras
+	uint64_t GetDroppedFrames() const {
+		uint64_t dropped = 0;
+		for (auto& channel : channels_)
+			dropped += channel->GetDroppedFrames();
+		return dropped;
 	}
 
+	// Render thread only. Never waits on the pipeline; the image is left
+	// untouched when no new frame was published since the last call.
+	bool GetImage(ofImage& image) { return Selected().GetImage(image); }
+
 private:
-	void FingerTracker::threadedFunction()
+	enum { FRAME_COUNT = 4 };
+	typedef SpscRing<TrackerFrame*, FRAME_COUNT> FrameRing;
+
+	CameraChannel& Selected() { return *channels_[selected_]; }
+
+	void UpdateTable()
 	{
-		contourFinder_->setAutoThreshold(true);
+		cv::Rect table(channels_[0]->Offset(), channels_[0]->ProcSize());
+		for (auto& channel : channels_)
+			table |= cv::Rect(channel->Offset(), channel->ProcSize());
+		table_ = table;
+	}
 
-		while (isThreadRunning()) {
-			inputCamera_->Grab([this](cv::Mat img) {
-				cv::cvtColor(img.clone(), gray_, cv::COLOR_RGB2GRAY);
-				cv::warpPerspective(gray_, gray_, pm_, gray_.size(), cv::INTER_NEAREST);
-				cv::resize(gray_, gray_, cv::Size(640/2, 480/2), 0, 0, 0);
-				cv::GaussianBlur(gray_, gray_, cv::Size(9, 9), 0, 0);
-				Gamma(gray_, gray_, 10);
+	/*
+	 capture -> preprocess + detect, per camera on threads of its own,
+	 then track on this thread -> output. Frames are preallocated and
+	 circulate through the rings: the tracker hands camera frames back to
+	 their channel once merged, the output stage hands tracker frames back
+	 to the tracker, so frame N+1 can be captured and preprocessed while
+	 frame N is being tracked or sent.
+	*/
+	void threadedFunction()
+	{
+		for (auto& frame : frames_) {
+			freeFrames_.Push(&frame);
+		}
+		round_.assign(channels_.size(), NULL);
+
+		tuioSender_.Start(tuioConfig_);
+
+		for (auto& channel : channels_)
+			channel->Start(&params_, &detected_);
+		stagesRunning_ = true;
+		std::thread output(&FingerTracker::OutputStage, this);
 
-				lock();
-				resultImg_ = (isCalibMode_) ? img : gray_.clone();
-				contourFinder_->findContours(gray_);
-				tracker_->track(contourFinder_->getBoundingRects());
-				sendTUIOData();
-				unlock();
-				});
-			Sleep(2);
+		TrackStage();
+
+		ReleaseRound();
+		for (auto& channel : channels_)
+			channel->Stop();
+		stagesRunning_ = false;
+		trackedFrames_.Wake();
+		output.join();
+		tuioSender_.Stop();
+
+		// leave the rings empty so a restart can hand out every frame again
+		TrackerFrame* frame;
+		while (freeFrames_.Pop(frame) || trackedFrames_.Pop(frame)) {
 		}
 	}
 
-
-	void sendTUIOData()
+	void TrackStage()
 	{
-		tuioServer_->initFrame(TUIO::TuioTime::getSessionTime());
-		for each (auto follower in  tracker_->getFollowers())
-		{
-			auto label = follower.getLabel();
-			auto center = follower.smooth;
+		while (isThreadRunning()) {
+			if (!CollectRound())
+				continue;
 
-			center.x /= (640/2);
-			center.y /= (480/2);
-			switch (follower.state_)
-			{
-			case FingerFollower::BORN:
-				cursors_[label] = tuioServer_->addTuioCursor(center.x, center.y);
-				break;
-
-			case FingerFollower::ALIVE:
-				tuioServer_->updateTuioCursor(cursors_[label], center.x, center.y);
-				break;
-
-			case FingerFollower::DEAD:
-				tuioServer_->removeTuioCursor(cursors_[label]);
-				follower.terminate();
-				cursors_.erase(label);
-				break;
-
-			default:
-				break;
+			TrackerFrame* frame = NULL;
+			while (!freeFrames_.WaitPop(frame, std::chrono::milliseconds(100))) {
+				if (!isThreadRunning())
+					return;
 			}
-		}
 
-		tuioServer_->commitFrame();
-	}
+			lock();
+			ApplyFinderParams();
+
+			// the newest frame of the round sets the clock and is the one measured
+			const ChannelFrame* newest = NULL;
+			bool detected = false;
+			for (const ChannelFrame* f : round_) {
+				if (f == NULL) continue;
+				if (newest == NULL || f->timestamp > newest->timestamp)
+					newest = f;
+				detected |= f->detected;
+			}
+			frame->timestamp = newest->timestamp;
+			frame->sequence = (round_[0] != NULL) ? round_[0]->sequence : 0;
+			for (int s = 0; s < STAGE_TRACK; s++)
+				frame->stamps[s] = newest->stamps[s];
+
+			// followers run on capture time, so the filter sees the real frame spacing
+			const uint64_t now = frame->timestamp;
+			if (detected) {
+				MergeRound(frame->timestamp);
+				UpdateFollowers(merged_, now);
+			}
+			followers_.tick(now);
+
+			frame->touches.clear();
+			for (size_t i = 0; i < followers_.size(); i++) {
+				TouchPoint touch;
+				touch.label = followers_.label[i];
+				touch.state = followers_.state[i];
+				touch.pos = followers_.smooth[i];
+				touch.vel = followers_.vel[i];
+				frame->touches.push_back(touch);
+			}
 
-public:
-	void SetCameraExposure(int arg) {
-		lock();
-		inputCamera_->SetExposure(arg);
-		unlock();
-	}
+			// DEAD followers made it into exactly one snapshot, the output
+			// stage removes their cursors from it
+			followers_.compact();
+			frame->stamps[STAGE_TRACK] = ofGetElapsedTimeMicros();
+			unlock();
 
-	void EnterCalibMode() { 
-		isCalibMode_ = true; 
-		picked_ = -1;
+			ReleaseRound();
+			trackedFrames_.Push(frame);
+		}
 	}
 
-	void SetCalib() {
-		SetPerspective(pts_src);
+	/*
+	 Takes at most one frame per camera into round_. The round is complete
+	 once every camera delivered, once a camera already in it has its next
+	 frame waiting, or alignWindow after its first frame; a camera that
+	 misses it joins the next round. With one camera, or cameras on a
+	 common sync, nothing waits.
+	*/
+	bool CollectRound()
+	{
+		size_t count = 0;
+		std::chrono::steady_clock::time_point deadline;
+		for (;;) {
+			const uint64_t signal = detected_.Value();
+			bool behind = false;
+			for (size_t c = 0; c < channels_.size(); c++) {
+				if (round_[c] != NULL) {
+					behind |= channels_[c]->Detected().Size() != 0;
+				}
+				else if (channels_[c]->Detected().Pop(round_[c])) {
+					if (count++ == 0)
+						deadline = std::chrono::steady_clock::now()
+							+ std::chrono::microseconds((int64_t)(finderParams_.alignWindow * 1e6f));
+				}
+			}
+
+			const auto now = std::chrono::steady_clock::now();
+			if (count == channels_.size() || (count != 0 && (behind || now >= deadline)))
+				return true;
+			if (!isThreadRunning())
+				return false;
+
+			if (count == 0)
+				detected_.Wait(signal, std::chrono::milliseconds(100));
+			else
+				detected_.Wait(signal, deadline - now);
+		}
 	}
 
-	void ExitCalibMode() { 
-		isCalibMode_ = false;
-		picked_ = -1;
+	void ReleaseRound()
+	{
+		for (size_t c = 0; c < round_.size(); c++) {
+			if (round_[c] != NULL)
+				channels_[c]->Release(round_[c]);
+			round_[c] = NULL;
+		}
 	}
-	bool IsCalibMode() { return isCalibMode_; }
 
-	void MoveClosestPoint(int x, int y) {
-		if (picked_ > -1) {
-			pts_src[picked_] = ofVec2f(x, y) + pickOffset_;
+	/*
+	 Detections of the round in table pixels, one per finger. Frames taken
+	 before the newest are first moved along the velocity of the nearest
+	 follower by their capture time difference. A detection closer than
+	 mergeDistance to one from another camera is the same finger seen in
+	 the overlap and is folded into it, weighted by area.
+	*/
+	void MergeRound(uint64_t timestamp)
+	{
+		merged_.clear();
+		mergedCameras_.clear();
+		const float merge2 = finderParams_.mergeDistance * finderParams_.mergeDistance;
+		for (size_t c = 0; c < round_.size(); c++) {
+			const ChannelFrame* frame = round_[c];
+			if (frame == NULL) continue;
+
+			const float dt = (float)(timestamp - frame->timestamp) * 1e-6f;
+			const uint32_t camera = 1u << (c % 32);
+			for (Blob blob : frame->blobs) {
+				if (dt > 0)
+					Align(blob, dt);
+
+				int match = -1;
+				float best = merge2;
+				for (size_t m = 0; m < merged_.size(); m++) {
+					if (mergedCameras_[m] & camera) continue;
+					const float dx = merged_[m].cx - blob.cx;
+					const float dy = merged_[m].cy - blob.cy;
+					const float d2 = dx * dx + dy * dy;
+					if (d2 <= best) {
+						best = d2;
+						match = (int)m;
+					}
+				}
+
+				if (match < 0) {
+					merged_.push_back(blob);
+					mergedCameras_.push_back(camera);
+				}
+				else {
+					Combine(merged_[match], blob);
+					mergedCameras_[match] |= camera;
+				}
+			}
 		}
 	}
 
-	void PickClosestPoint(int x, int y) {
-		auto cls = 9999999.9;
-		for (size_t i = 0; i < 4; i++)
-		{
-			auto v = pts_src[i] - ofVec2f(x, y);
-			auto d = v.length();
-			if (cls > d) {
-				picked_ = i;
-				cls = d;
-				pickOffset_ = v;
+	// moves an older detection to where the closest follower has gone since
+	void Align(Blob& blob, float dt)
+	{
+		int nearest = -1;
+		float best = finderParams_.maxDistance * finderParams_.maxDistance;
+		for (size_t i = 0; i < followers_.size(); i++) {
+			const float d2 = followers_.cur[i].squareDistance(ofVec2f(blob.cx, blob.cy));
+			if (d2 <= best) {
+				best = d2;
+				nearest = (int)i;
 			}
 		}
+		if (nearest < 0) return;
+		blob.cx += followers_.vel[nearest].x * dt;
+		blob.cy += followers_.vel[nearest].y * dt;
 	}
 
-	void draw() {
-		DrawSrcRect();
+	// shape from the larger view, the smaller one is usually cut by its camera's edge
+	static void Combine(Blob& a, const Blob& b)
+	{
+		const float wa = (float)a.area, wb = (float)b.area;
+		a.cx = (a.cx * wa + b.cx * wb) / (wa + wb);
+		a.cy = (a.cy * wa + b.cy * wb) / (wa + wb);
+		if (b.area > a.area) {
+			a.mxx = b.mxx;
+			a.myy = b.myy;
+			a.mxy = b.mxy;
+			a.angle = b.angle;
+			a.area = b.area;
+		}
+		a.bbox |= b.bbox;
+		a.peak = std::max(a.peak, b.peak);
+	}
 
-		lock();
-		ofSetColor(255, 0, 0);
-		contourFinder_->draw();
+	// labels from the tracker are matched to followers by label, never by copy
+	void UpdateFollowers(const std::vector<Blob>& blobs, uint64_t now)
+	{
+		points_.resize(blobs.size());
+		for (size_t i = 0; i < blobs.size(); i++) {
+			points_[i] = cv::Point2f(blobs[i].cx, blobs[i].cy);
+		}
 
-		for each (auto follower in  tracker_->getFollowers()) {
-			follower.draw();
+		const std::vector<unsigned int>& labels = tracker_->Track(points_);
+		for (size_t i = 0; i < labels.size(); i++) {
+			int f = followers_.find(labels[i]);
+			if (f < 0)
+				followers_.add(labels[i], blobs[i], now);
+			else
+				followers_.update(f, blobs[i], now);
+		}
+
+		for (auto label : tracker_->DeadLabels()) {
+			int f = followers_.find(label);
+			if (f >= 0)
+				followers_.kill(f, now);
 		}
-		unlock();
 	}
 
-	void reset_rect() {
-		pts_src.clear();
-		pts_src.push_back(ofVec2f(0, 0));
-		pts_src.push_back(ofVec2f(640 - 1, 0));
-		pts_src.push_back(ofVec2f(640 - 1, 480 - 1));
-		pts_src.push_back(ofVec2f(0, 480 - 1));
-		SetPerspective(pts_src);
+	void OutputStage()
+	{
+		TrackerFrame* frame;
+		while (stagesRunning_) {
+			if (!trackedFrames_.WaitPop(frame, std::chrono::milliseconds(100)))
+				continue;
+
+			ApplyOutputParams();
+
+			// capture -> output, averaged over a few frames
+			const float latency = (float)(ofGetElapsedTimeMicros() - frame->timestamp) * 1e-6f;
+			const float average = latency_;
+			latency_ = (average > 0) ? average + (latency - average) * 0.1f : latency;
+
+			// extrapolate to when the cursor is expected on screen
+			const float horizon = std::min(latency_ + outputParams_.predictionOffset, outputParams_.maxPrediction);
+			sendTUIOData(*frame, std::max(horizon, 0.0f));
+			publishSharedTouches(*frame, std::max(horizon, 0.0f));
+			frame->stamps[STAGE_COMMIT] = ofGetElapsedTimeMicros();
+			RecordLatency(*frame);
+			if (outputListener_)
+				outputListener_(*frame);
+
+			freeFrames_.Push(frame);
+		}
 	}
 
-	void DrawSrcRect() {
-		if (isCalibMode_) {
-			ofNoFill();
-			ofSetColor(255, 0, 0);
-			ofDrawCircle(pts_src[0], 10);
-			ofDrawBitmapString("0", pts_src[0]);
-			ofDrawLine(pts_src[0], pts_src[1]);
+	void RecordLatency(const TrackerFrame& frame)
+	{
+		uint64_t last = frame.timestamp;
+		for (int s = 0; s < STAGE_TOTAL; s++) {
+			// clocks only move forward, guard against a backend stamping late
+			const uint64_t stamp = std::max(frame.stamps[s], last);
+			stageLatency_[s].Record(stamp - last);
+			last = stamp;
+		}
+		stageLatency_[STAGE_TOTAL].Record(last - frame.timestamp);
+	}
 
-			ofSetColor(0, 255, 0);
-			ofDrawCircle(pts_src[1], 10);
-			ofDrawBitmapString("1", pts_src[1]);
-			ofDrawLine(pts_src[1], pts_src[2]);
+	// extrapolated horizon seconds along the follower's velocity, normalized to 0..1 over the table
+	ofVec2f OutputPosition(const TouchPoint& touch, float horizon) const {
+		auto center = touch.pos + touch.vel * horizon;
+		return ofVec2f(ofClamp((center.x - table_.x) / table_.width, 0, 1), ofClamp((center.y - table_.y) / table_.height, 0, 1));
+	}
 
-			ofSetColor(0, 0, 255);
-			ofDrawCircle(pts_src[2], 10);
-			ofDrawBitmapString("2", pts_src[2]);
-			ofDrawLine(pts_src[2], pts_src[3]);
+	ofVec2f OutputVelocity(const TouchPoint& touch) const {
+		return ofVec2f(touch.vel.x / table_.width, touch.vel.y / table_.height);
+	}
 
-			ofSetColor(255, 255, 0);
-			ofDrawCircle(pts_src[3], 10);
-			ofDrawBitmapString("3", pts_src[3]);
-			ofDrawLine(pts_src[3], pts_src[0]);
-			ofFill();
+	// only ever called from the output stage, which owns snapshot_
+	void sendTUIOData(const TrackerFrame& frame, float horizon)
+	{
+		snapshot_.timestamp = frame.timestamp;
+		snapshot_.cursors.clear();
+		for (auto& touch : frame.touches)
+		{
+			// nasent followers have no cursor yet, dead ones are dropped from the alive set
+			if (touch.state != FingerFollowers::BORN && touch.state != FingerFollowers::ALIVE)
+				continue;
+
+			auto pos = OutputPosition(touch, horizon);
+			auto vel = OutputVelocity(touch);
+			TuioSnapshotCursor cursor;
+			cursor.id = touch.label;
+			cursor.x = pos.x;
+			cursor.y = pos.y;
+			cursor.vx = vel.x;
+			cursor.vy = vel.y;
+			snapshot_.cursors.push_back(cursor);
 		}
+		tuioSender_.Send(snapshot_);
 	}
 
 	/*
-	 (0,0)        (640-1,0)
-	    0--------- 1
-	    |          |
-	    |          |
-	    3----------2
-	 (0,480-1)    (640-1,480-1)
+	 Same positions as TUIO, plus the frame in which a touch ends. DOWN is
+	 the first frame a label is published in, however long it stays BORN;
+	 a follower that dies before it was ever published has no UP either.
+
+	 Touches already reported go first, so their MOVE and UP always fit in
+	 a frame; with more than MAX_TOUCHES it is new touches that wait.
 	*/
-	void SetPerspective(std::vector<ofVec2f> rect) {
-		if (rect.size() != 4) return;
+	void publishSharedTouches(const TrackerFrame& frame, float horizon)
+	{
+		if (!touchRing_.IsOpen())
+			return;
 
-		pts_src.clear();
-		std::vector<cv::Point2f> src;
-		for (size_t i = 0; i < 4; i++)
-		{
-			pts_src.push_back(rect[i]);
-			src.push_back(cv::Point2f(rect[i].x, rect[i].y));
+		ringTouches_.clear();
+		for (int pass = 0; pass < 2; pass++) {
+			for (auto& touch : frame.touches)
+			{
+				const bool touching = touch.state == FingerFollowers::BORN || touch.state == FingerFollowers::ALIVE;
+				const bool reported = IsRingReported(touch.label);
+				int state;
+				if (pass == 0 && reported && touching) {
+					state = touchring::MOVE;
+				}
+				else if (pass == 0 && reported && touch.state == FingerFollowers::DEAD) {
+					state = touchring::UP;
+					SetRingReported(touch.label, false);
+				}
+				else if (pass == 1 && !reported && touching && ringTouches_.size() < touchring::MAX_TOUCHES) {
+					state = touchring::DOWN;
+					SetRingReported(touch.label, true);
+				}
+				else {
+					continue;
+				}
+				PushRingTouch(touch, state, horizon);
+			}
 		}
+		touchRing_.Publish(frame.timestamp, ringTouches_.data(), ringTouches_.size());
+	}
+
+	// ringReported_ is sorted; there is room for a label whenever the frame has room for its DOWN
+	bool IsRingReported(int label) const {
+		return std::binary_search(ringReported_, ringReported_ + ringReportedCount_, label);
+	}
 
-		std::vector<cv::Point2f> dst;
-		dst.push_back(cv::Point2f(0, 0));
-		dst.push_back(cv::Point2f(640 - 1, 0));
-		dst.push_back(cv::Point2f(640 - 1, 480 - 1));
-		dst.push_back(cv::Point2f(0, 480 - 1));
+	void SetRingReported(int label, bool reported) {
+		int* end = ringReported_ + ringReportedCount_;
+		int* it = std::lower_bound(ringReported_, end, label);
+		if (reported && ringReportedCount_ < touchring::MAX_TOUCHES) {
+			std::copy_backward(it, end, end + 1);
+			*it = label;
+			ringReportedCount_++;
+		}
+		else if (!reported && it != end && *it == label) {
+			std::copy(it + 1, end, it);
+			ringReportedCount_--;
+		}
+	}
+
+	void PushRingTouch(const TouchPoint& touch, int state, float horizon)
+	{
+		auto pos = OutputPosition(touch, horizon);
+		auto vel = OutputVelocity(touch);
+		TouchRingTouch t;
+		t.id = touch.label;
+		t.state = state;
+		t.x = pos.x;
+		t.y = pos.y;
+		t.vx = vel.x;
+		t.vy = vel.y;
+		ringTouches_.push_back(t);
+	}
+
+public:
+	// calibration works on the selected camera
+	void EnterCalibMode() { Selected().EnterCalibMode(); }
+	void SetCalib() { Selected().SetCalib(); }
+	void ExitCalibMode() { Selected().ExitCalibMode(); }
+	bool IsCalibMode() { return Selected().IsCalibMode(); }
+	void MoveClosestPoint(int x, int y) { Selected().MoveClosestPoint(x, y); }
+	void PickClosestPoint(int x, int y) { Selected().PickClosestPoint(x, y); }
+	void reset_rect() { Selected().reset_rect(); }
 
+	void draw() {
+		Selected().DrawSrcRect();
+		Selected().DrawContours();
+
+		// followers are in table pixels, the image is the selected camera's
+		const cv::Point offset = Selected().Offset();
+		const cv::Point2f scale = Selected().DisplayScale();
+		ofPushMatrix();
+		ofScale(scale.x, scale.y);
+		ofTranslate(-offset.x, -offset.y);
 		lock();
-		pm_ = cv::getPerspectiveTransform(src, dst);
+		const uint64_t now = ofGetElapsedTimeMicros();
+		for (size_t i = 0; i < followers_.size(); i++) {
+			followers_.draw((int)i, now);
+		}
 		unlock();
+		ofPopMatrix();
+	}
+
+	void SetPerspective(std::vector<ofVec2f> rect, size_t channel = 0) {
+		channels_[channel]->SetPerspective(rect);
+	}
+
+	cv::Mat GetPerspective(size_t channel = 0) {
+		return channels_[channel]->GetPerspective();
+	}
+
+	const std::vector<ofVec2f>& GetCalibRect(size_t channel = 0) const {
+		return channels_[channel]->pts_src;
 	}
 
 public:
-	void SetFinderParam(int th, int minar, int maxar) {
-		threshold_ = th;
-		minAreaRadius_ = minar;
-		maxAreaRadius_ = maxar;
+	// UI thread. Cheap to call every frame: a new version is only published
+	// when something actually changed, and nothing here takes the tracker lock.
+	void SetParams(const TrackerParams& params) {
+		if (params_.Version() != 0 && memcmp(&params, &uiParams_, sizeof(TrackerParams)) == 0)
+			return;
+		uiParams_ = params;
+		params_.Publish(params);
+	}
+
+	// UI thread, only takes the tracker lock when the setting changes
+	void SetTrailEnabled(bool enabled) {
+		if (enabled == trailEnabled_) return;
+		trailEnabled_ = enabled;
 		lock();
-		contourFinder_->setThreshold(threshold_);
-		contourFinder_->setMinAreaRadius(minAreaRadius_);
-		contourFinder_->setMaxAreaRadius(maxAreaRadius_);
-		tracker_->setPersistence(15);	// wait for half a second before forgetting something
-		tracker_->setMaximumDistance(32);	// an object can move up to 32 pixels per frame
+		followers_.setTrailEnabled(enabled);
 		unlock();
 	}
 
+	// any thread, the background of every camera is relearned from the next frame
+	void ResetBackground() {
+		for (auto& channel : channels_)
+			channel->ResetBackground();
+	}
+
+	// traces contours with ofxCv next to the blob detector so draw() can show them
+	void SetDebugContours(bool enabled) {
+		for (auto& channel : channels_)
+			channel->SetDebugContours(enabled);
+	}
+
+	// called on the output stage with every frame right after it was sent;
+	// set it before startThread(), it is not synchronised
+	void SetOutputListener(std::function<void(const TrackerFrame&)> listener) { outputListener_ = listener; }
+
+	// a camera's resolution, the space its calibration is in
+	cv::Size GetCameraSize(size_t channel = 0) const { return channels_[channel]->CameraSize(); }
+
+	// size of a camera's warped image in tracker pixels
+	cv::Size GetProcSize(size_t channel = 0) const { return channels_[channel]->ProcSize(); }
+
+	// all cameras' warped images in tracker pixels, the touch positions refer to it
+	cv::Rect GetTable() const { return table_; }
+
+	// capture -> TUIO output in seconds, averaged; also the base of the prediction horizon
+	float GetLatency() const { return latency_; }
+
+	// any thread, the histograms are updated lock-free by the output stage
+	LatencyStats GetLatencyStats(LatencyStage stage) const {
+		const LatencyHistogram& h = stageLatency_[stage];
+		LatencyStats stats;
+		stats.p50 = h.Percentile(0.5);
+		stats.p99 = h.Percentile(0.99);
+		stats.max = h.Max();
+		stats.count = h.Count();
+		return stats;
+	}
+
+	void ResetLatencyStats() {
+		for (auto& h : stageLatency_) h.Reset();
+	}
+
+	static const char* StageName(LatencyStage stage) {
+		static const char* names[STAGE_COUNT] = { "grab", "preprocess", "detect", "track", "commit", "total" };
+		return names[stage];
+	}
+
+	void DrawLatencyStats(int x, int y) {
+		ofSetColor(255, 255, 0);
+		ofDrawBitmapString("stage        p50     p99     max  (us)", x, y);
+		for (int s = 0; s < STAGE_COUNT; s++) {
+			const LatencyStats stats = GetLatencyStats((LatencyStage)s);
+			char line[96];
+			snprintf(line, sizeof(line), "%-10s %7llu %7llu %7llu", StageName((LatencyStage)s),
+				(unsigned long long)stats.p50, (unsigned long long)stats.p99, (unsigned long long)stats.max);
+			ofDrawBitmapString(line, x, y + 15 * (s + 1));
+		}
+	}
+
 	ofxCv::ContourFinder* ContourFinder() {
-		return contourFinder_.get();
+		return Selected().ContourFinder();
 	}
 
 
 private:
-	int threshold_;
-	int minAreaRadius_;
-	int maxAreaRadius_;
-	cv::Mat pm_;
-	cv::Mat resultImg_;
-	bool isCalibMode_;
-	cv::Mat img_;
-	cv::Mat gray_;
-	cv::Mat bg_;
-	ofVec2f pickOffset_;
-	int picked_;
-
-	MyCamBase* inputCamera_;
-	std::map<int, TUIO::TuioCursor*> cursors_;
-
-	std::unique_ptr<TUIO::TuioServer> tuioServer_;
-	std::unique_ptr<ofxCv::ContourFinder> contourFinder_;
-	std::unique_ptr<ofxCv::RectTrackerFollower<FingerFollower> > tracker_;
+	// track stage, applied under the lock it already holds for the frame
+	void ApplyFinderParams() {
+		TrackerParams params = finderParams_;
+		if (!params_.Read(params, finderVersion_))
+			return;
+
+		if (params.persistence != finderParams_.persistence || !finderApplied_)
+			tracker_->SetPersistence(params.persistence);
+		if (params.maxDistance != finderParams_.maxDistance || !finderApplied_)
+			tracker_->SetMaximumDistance(params.maxDistance);
+		if (params.minCutoff != finderParams_.minCutoff
+			|| params.beta != finderParams_.beta
+			|| !finderApplied_)
+			followers_.setFilter(params.minCutoff, params.beta);
+
+		finderParams_ = params;
+		finderApplied_ = true;
+	}
 
-public:
-	std::vector<ofVec2f> pts_src;
-};
\ No newline at end of file
+	// output stage, prediction settings are plain values so nothing to diff
+	void ApplyOutputParams() {
+		params_.Read(outputParams_, outputVersion_);
+	}
+
+	ParamBlock<TrackerParams> params_;
+	TrackerParams uiParams_;
+	TrackerParams finderParams_;
+	TrackerParams outputParams_;
+	uint64_t finderVersion_ = 0;
+	uint64_t outputVersion_ = 0;
+	bool finderApplied_ = false;
+
+	TrackerResolution resolution_;
+	cv::Rect table_;	// union of the cameras' images, what TUIO 0..1 spans
+	std::vector<std::unique_ptr<CameraChannel>> channels_;
+	size_t selected_;
+	RingSignal detected_;	// any channel pushed to Detected()
+	std::vector<ChannelFrame*> round_;	// per channel, NULL when it has no frame in the round
+	std::vector<Blob> merged_;
+	std::vector<uint32_t> mergedCameras_;	// bit per channel that saw the merged blob
+
+	TuioOutputConfig tuioConfig_;
+	TuioSender tuioSender_;
+	TuioSnapshot snapshot_;
+	TouchRingWriter touchRing_;
+	std::vector<TouchRingTouch> ringTouches_;
+	int ringReported_[touchring::MAX_TOUCHES];	// labels published DOWN and not yet UP, sorted
+	size_t ringReportedCount_;
+	std::unique_ptr<SpatialTracker> tracker_;
+	std::vector<cv::Point2f> points_;
+	FingerFollowers followers_;
+	bool trailEnabled_;	// as last set from the UI thread
+
+	TrackerFrame frames_[FRAME_COUNT];
+	FrameRing freeFrames_;
+	FrameRing trackedFrames_;
+	std::atomic<bool> stagesRunning_;
+	std::atomic<float> latency_;
+	LatencyHistogram stageLatency_[STAGE_COUNT];
+	std::function<void(const TrackerFrame&)> outputListener_;
+};
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <utility>
+
+class FramePool;
+
+struct FrameSlot {
+	cv::Mat image;
+	uint64_t sequence;
+	uint64_t timestamp;	// ofGetElapsedTimeMicros() when the camera delivered the frame
+
+	FramePool* pool;
+	int index;
+	std::atomic<int> refs;
+};
+
+/*
+ Reference-counted handle to a FrameSlot. Copies share the slot, the
+ slot goes back to its pool when the last handle is released.
+*/
+class FrameRef
+{
+public:
+	FrameRef() : slot_(NULL) {}
+	explicit FrameRef(FrameSlot* slot) : slot_(slot) {}
+
+	FrameRef(const FrameRef& other) : slot_(other.slot_) {
+		if (slot_ != NULL)
+			slot_->refs.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	FrameRef(FrameRef&& other) : slot_(other.slot_) {
+		other.slot_ = NULL;
+	}
+
+	FrameRef& operator=(FrameRef other) {
+		std::swap(slot_, other.slot_);
+		return *this;
+	}
+
+	~FrameRef() { Release(); }
+
+	inline void Release();
+
+	explicit operator bool() const { return slot_ != NULL; }
+	FrameSlot* operator->() const { return slot_; }
+
+private:
+	FrameSlot* slot_;
+};
+
+/*
+ Fixed set of preallocated images (at most 64). Acquire and release are
+ lock-free, a single atomic bitmask tracks which slots are free, so slots
+ can be released from any thread. Nothing is allocated after Allocate().
+*/
+class FramePool
+{
+public:
+	enum { MAX_SLOTS = 64 };
+
+	FramePool() : count_(0), free_(0) {}
+
+	// not thread-safe, call before any frame is handed out
+	void Allocate(int w, int h, int type, int count) {
+		count_ = std::min(count, (int)MAX_SLOTS);
+		slots_.reset(new FrameSlot[count_]);
+		for (int i = 0; i < count_; i++) {
+			slots_[i].image.create(h, w, type);
+			slots_[i].sequence = 0;
+			slots_[i].timestamp = 0;
+			slots_[i].pool = this;
+			slots_[i].index = i;
+			slots_[i].refs = 0;
+		}
+		free_ = (count_ == 64) ? ~0ull : ((1ull << count_) - 1);
+	}
+
+	// returns an empty ref when every slot is in use
+	FrameRef Acquire() {
+		uint64_t mask = free_.load(std::memory_order_acquire);
+		while (mask != 0) {
+			const uint64_t bit = mask & (~mask + 1);
+			if (free_.compare_exchange_weak(mask, mask & ~bit, std::memory_order_acq_rel)) {
+				int index = 0;
+				while ((bit >> index) != 1)
+					index++;
+
+				FrameSlot* slot = &slots_[index];
+				slot->refs.store(1, std::memory_order_relaxed);
+				return FrameRef(slot);
+			}
+		}
+		return FrameRef();
+	}
+
+	int Size() const { return count_; }
+
+	// direct access for backends that bind per-slot resources at start-up
+	FrameSlot& Slot(int index) { return slots_[index]; }
+
+private:
+	friend class FrameRef;
+
+	void Free(int index) {
+		free_.fetch_or(1ull << index, std::memory_order_release);
+	}
+
+	int count_;
+	std::unique_ptr<FrameSlot[]> slots_;
+	std::atomic<uint64_t> free_;
+};
+
+inline void FrameRef::Release() {
+	if (slot_ == NULL) return;
+	if (slot_->refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+		slot_->pool->Free(slot_->index);
+	slot_ = NULL;
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+/*
+ Log-bucketed histogram of durations in microseconds.
+
+ Every power of two is split into 8 linear sub-buckets, so any reported
+ value is within 12.5% of the recorded one. Record() is a couple of
+ relaxed atomic increments and never blocks; readers may run on any
+ thread and see a slightly stale but consistent-enough picture.
+*/
+class LatencyHistogram
+{
+public:
+	LatencyHistogram() { Reset(); }
+
+	void Record(uint64_t us) {
+		if (us > MAX_VALUE) us = MAX_VALUE;
+		buckets_[Bucket(us)].fetch_add(1, std::memory_order_relaxed);
+		count_.fetch_add(1, std::memory_order_relaxed);
+
+		uint64_t max = max_.load(std::memory_order_relaxed);
+		while (us > max && !max_.compare_exchange_weak(max, us, std::memory_order_relaxed)) {
+		}
+	}
+
+	// upper bound of the bucket holding the p-th fraction (0..1) of the samples
+	uint64_t Percentile(double p) const {
+		const uint64_t count = count_.load(std::memory_order_relaxed);
+		if (count == 0) return 0;
+
+		const uint64_t rank = (uint64_t)(p * count + 0.5);
+		uint64_t seen = 0;
+		for (int b = 0; b < BUCKETS; b++) {
+			seen += buckets_[b].load(std::memory_order_relaxed);
+			if (seen >= rank && seen > 0) {
+				const uint64_t max = Max();
+				const uint64_t upper = UpperBound(b);
+				return (upper < max) ? upper : max;
+			}
+		}
+		return Max();
+	}
+
+	uint64_t Max() const { return max_.load(std::memory_order_relaxed); }
+	uint64_t Count() const { return count_.load(std::memory_order_relaxed); }
+
+	// not atomic as a whole, samples recorded meanwhile may be half counted
+	void Reset() {
+		for (int b = 0; b < BUCKETS; b++)
+			buckets_[b].store(0, std::memory_order_relaxed);
+		count_.store(0, std::memory_order_relaxed);
+		max_.store(0, std::memory_order_relaxed);
+	}
+
+private:
+	enum {
+		SUB_BITS = 3,
+		SUB = 1 << SUB_BITS,
+		BUCKETS = (32 - SUB_BITS + 1) * SUB
+	};
+	static const uint64_t MAX_VALUE = 0xFFFFFFFFull;
+
+	static int Bucket(uint64_t us) {
+		if (us < SUB) return (int)us;
+		int e = 0;
+		while ((us >> (e + 1)) != 0)
+			e++;
+		return (e - SUB_BITS + 1) * SUB + (int)((us >> (e - SUB_BITS)) & (SUB - 1));
+	}
+
+	static uint64_t UpperBound(int b) {
+		if (b < SUB) return (uint64_t)b;
+		const int g = b / SUB;
+		const uint64_t low = (uint64_t)(SUB + b % SUB) << (g - 1);
+		return low + (1ull << (g - 1)) - 1;
+	}
+
+	std::atomic<uint64_t> buckets_[BUCKETS];
+	std::atomic<uint64_t> count_;
+	std::atomic<uint64_t> max_;
+};
@@ -1,31 +1,719 @@
+#include <random>
+
 class MyCamBase {
 public:
+	// enough for every frame the tracker pipeline can hold at once, plus the
+	// one being filled and the three display buffers
+	enum { POOL_SIZE = 10 };
+
+	// native layout of the frames a backend hands out
+	enum PixelFormat {
+		GRAY8,	// single channel, IR cameras
+		RGB24,
+		RGBA32
+	};
+
 	MyCamBase(int reqW, int reqH)
 	{
 		w = reqW;
 		h = reqH;
 	}
 
+	virtual ~MyCamBase() {}
+
 	virtual void Start() = 0;
 	virtual void Stop() = 0;
-	virtual void Grab(std::function<void(cv::Mat)> func) = 0;
+
+	// Hands the newest frame to func without copying it. The frame belongs to
+	// the camera's pool and is recycled once every FrameRef to it is gone.
+	virtual void Grab(std::function<void(FrameRef)> func) = 0;
 	virtual void SetExposure(int) {}
 
+	// frames skipped because the pool was exhausted
+	virtual uint64_t GetDroppedFrames() const { return dropped_; }
+
+	// Live sources keep running whether or not the tracker keeps up, so the
+	// tracker drops frames instead of falling behind. Recorded sources can wait.
+	virtual bool IsLive() const { return true; }
+
+	// extra pool slots for frames a wrapper holds on top of the pipeline,
+	// such as MyRecordingCam's queue; call before Start()
+	void ReservePoolSlots(int extra) { extraSlots_ = extra; }
+
+	// valid once Start() has returned
+	PixelFormat GetPixelFormat() const { return format_; }
+	int GetWidth() const { return w; }
+	int GetHeight() const { return h; }
+
+	// Blocks until the backend has signalled a new frame or the timeout expires.
+	// Returns false on timeout, Grab can then be skipped.
+	virtual bool WaitFrame(std::chrono::milliseconds timeout) {
+		std::unique_lock<std::mutex> guard(frameMutex_);
+		bool ready = frameCond_.wait_for(guard, timeout, [this] { return frameSeq_ != waitedSeq_; });
+		waitedSeq_ = frameSeq_;
+		return ready;
+	}
+
 protected:
-	ofPixels pixels_;
+	// sizes the pool for the backend's native format, call from Start() once w/h are known
+	void AllocatePool(PixelFormat format) {
+		static const int types[] = { CV_8UC1, CV_8UC3, CV_8UC4 };
+		format_ = format;
+		pool_.Allocate(w, h, types[format], POOL_SIZE + extraSlots_);
+	}
+
+	// For backends whose frames already sit in memory of their own: the slots
+	// have no pixels, every acquired slot's image is pointed at the frame.
+	void AllocateHeaderPool(PixelFormat format) {
+		format_ = format;
+		pool_.Allocate(0, 0, CV_8UC1, POOL_SIZE + extraSlots_);
+	}
+
+	// next free pool slot, stamped with sequence number and camera timestamp
+	// (arrival of the newest frame, or now if the backend never stamped one);
+	// empty when the consumers still hold every slot
+	FrameRef AcquireFrame() {
+		FrameRef frame = TryAcquireFrame();
+		if (!frame)
+			dropped_++;
+		return frame;
+	}
+
+	// as AcquireFrame, but an exhausted pool is not counted as a drop
+	FrameRef TryAcquireFrame() {
+		FrameRef frame = pool_.Acquire();
+		if (frame) {
+			const uint64_t arrival = arrival_;
+			frame->sequence = ++grabbed_;
+			frame->timestamp = (arrival != 0) ? arrival : ofGetElapsedTimeMicros();
+		}
+		return frame;
+	}
+
+	// records when the newest frame reached the host
+	void StampArrival() {
+		arrival_ = ofGetElapsedTimeMicros();
+	}
+
+	// for backends that make their frames themselves: the frame arrives when
+	// it is handed out, not when its slot was acquired
+	void StampFrame(FrameRef& frame) {
+		const uint64_t now = ofGetElapsedTimeMicros();
+		arrival_ = now;
+		frame->timestamp = now;
+	}
+
+	// called by the backend, from any thread, whenever a frame becomes available
+	void NotifyFrame() {
+		StampArrival();
+		SignalFrame();
+	}
+
+	// NotifyFrame without stamping, for frames already stamped by StampFrame
+	void SignalFrame() {
+		{
+			std::lock_guard<std::mutex> guard(frameMutex_);
+			frameSeq_++;
+		}
+		frameCond_.notify_all();
+	}
+
+	FramePool pool_;
+	PixelFormat format_ = RGBA32;
 	int w, h;
+
+private:
+	int extraSlots_ = 0;
+	uint64_t grabbed_ = 0;
+	std::atomic<uint64_t> dropped_{ 0 };
+	std::atomic<uint64_t> arrival_{ 0 };
+
+	std::mutex frameMutex_;
+	std::condition_variable frameCond_;
+	uint64_t frameSeq_ = 0;
+	uint64_t waitedSeq_ = 0;
+};
+
+/*
+ Base for sources that make their own frames on a producer thread, such
+ as recordings and generated scenes.
+
+ Real-time mode releases frames at their FrameTime() spacing and behaves
+ like a live camera: a frame nobody grabbed in time is replaced. Otherwise
+ every frame is handed out as soon as the previous one was grabbed, and
+ IsLive() tells the tracker to wait for the pipeline instead of dropping
+ frames.
+*/
+class MyPacedCam : public MyCamBase
+{
+public:
+	MyPacedCam(int w, int h, bool realtime, bool loop)
+		: MyCamBase(w, h), realtime_(realtime), loop_(loop) {}
+
+	~MyPacedCam() { StopThread(); }
+
+	void Stop() { StopThread(); }
+
+	void Grab(std::function<void(FrameRef)> func) {
+		FrameRef frame;
+		{
+			std::lock_guard<std::mutex> guard(mutex_);
+			std::swap(frame, pending_);
+		}
+		cond_.notify_all();
+
+		if (frame)
+			func(frame);
+	}
+
+	bool IsLive() const { return realtime_; }
+
+	// the last frame was handed out and looping is off
+	bool IsFinished() const { return finished_; }
+
+protected:
+	// number of frames, 0 for an endless source
+	virtual size_t FrameCount() const = 0;
+
+	// microseconds from the first frame to frame i
+	virtual uint64_t FrameTime(size_t i) const = 0;
+
+	// fills frame i into a freshly acquired slot; false skips it
+	virtual bool Render(size_t i, FrameRef& frame) = 0;
+
+	// call at the end of the subclass' Start(), once the pool is allocated
+	void StartThread() {
+		running_ = true;
+		finished_ = false;
+		thread_ = std::thread(&MyPacedCam::Run, this);
+	}
+
+	// subclasses call this from their destructor, before their own state goes away
+	void StopThread() {
+		{
+			std::lock_guard<std::mutex> guard(mutex_);
+			running_ = false;
+		}
+		cond_.notify_all();
+		if (thread_.joinable())
+			thread_.join();
+
+		std::lock_guard<std::mutex> guard(mutex_);
+		pending_.Release();
+	}
+
+private:
+	void Run() {
+		do {
+			const auto start = std::chrono::steady_clock::now();
+			const size_t count = FrameCount();
+			for (size_t i = 0; count == 0 || i < count; i++) {
+				std::unique_lock<std::mutex> guard(mutex_);
+				if (realtime_) {
+					// live cameras don't wait for anyone, an unclaimed frame is replaced
+					const auto due = start + std::chrono::microseconds(FrameTime(i));
+					cond_.wait_until(guard, due, [this] { return !running_; });
+				}
+				else {
+					cond_.wait(guard, [this] { return !running_ || !pending_; });
+				}
+				if (!running_)
+					return;
+				guard.unlock();
+
+				FrameRef frame = realtime_ ? AcquireFrame() : WaitFreeSlot();
+				if (!frame || !Render(i, frame))
+					continue;
+
+				// stamped now, after rendering, as a camera would on arrival
+				StampFrame(frame);
+				guard.lock();
+				pending_ = std::move(frame);
+				guard.unlock();
+				SignalFrame();
+			}
+		} while (loop_ && running_);
+
+		std::unique_lock<std::mutex> guard(mutex_);
+		cond_.wait(guard, [this] { return !running_ || !pending_; });
+		finished_ = true;
+	}
+
+	// Fast mode hands out every frame: while the tracker still holds every
+	// slot, wait for one to come back rather than skip the frame. Empty
+	// only once the source is stopped.
+	FrameRef WaitFreeSlot() {
+		for (;;) {
+			FrameRef frame = TryAcquireFrame();
+			if (frame)
+				return frame;
+			// slots are freed from any thread without a signal, poll briefly
+			std::unique_lock<std::mutex> guard(mutex_);
+			if (cond_.wait_for(guard, std::chrono::milliseconds(1), [this] { return !running_; }))
+				return FrameRef();
+		}
+	}
+
+	bool realtime_;
+	bool loop_;
+
+	std::thread thread_;
+	std::mutex mutex_;
+	std::condition_variable cond_;
+	bool running_ = false;
+	std::atomic<bool> finished_{ false };
+	FrameRef pending_;
 };
 
+/*
+ Plays back a recorded sequence, for benchmarks and regression runs
+ without a camera.
+
+ path is either a .raw recording (see rawRecording.h), whose frames are
+ handed out straight from the memory mapping, or a directory of images
+ (png/bmp/pgm, replayed in file name order) with an optional
+ timestamps.txt holding one capture time in microseconds per line.
+*/
+class MyReplayCam : public MyPacedCam
+{
+public:
+	MyReplayCam(const std::string& path, bool realtime, bool loop = false)
+		: MyPacedCam(0, 0, realtime, loop), path_(path) {}
+
+	~MyReplayCam() { StopThread(); }
+
+	void Start() {
+		if (ofFilePath::getFileExt(path_) == "raw") {
+			if (!OpenRecording())
+				return;
+		}
+		else if (!OpenImages()) {
+			return;
+		}
+		StartThread();
+	}
+
+	// calibration and parameters of a .raw replay, NULL for image sequences
+	const RawRecording* GetRecording() const { return recording_.IsOpen() ? &recording_ : NULL; }
+
+protected:
+	size_t FrameCount() const { return timestamps_.size(); }
+	uint64_t FrameTime(size_t i) const { return timestamps_[i] - timestamps_[0]; }
+
+	bool Render(size_t i, FrameRef& frame) {
+		// recordings use a pool of bare headers, the slot just points into the mapping
+		if (recording_.IsOpen()) {
+			frame->image = recording_.Frame((uint32_t)i);
+			return true;
+		}
+		return Decode(files_[i], frame->image);
+	}
+
+private:
+	bool OpenRecording() {
+		if (!recording_.Open(path_) || recording_.Count() == 0) {
+			printf("replay: cannot open recording %s\n", path_.c_str());
+			return false;
+		}
+
+		const RawRecordingHeader& header = recording_.Header();
+		w = header.width;
+		h = header.height;
+		// Open() has checked the format
+		AllocateHeaderPool((PixelFormat)header.format);
+
+		timestamps_.resize(recording_.Count());
+		for (size_t i = 0; i < timestamps_.size(); i++)
+			timestamps_[i] = recording_.Index((uint32_t)i).timestamp;
+		return true;
+	}
+
+	bool OpenImages() {
+		ofDirectory dir(path_);
+		dir.allowExt("png");
+		dir.allowExt("bmp");
+		dir.allowExt("pgm");
+		dir.listDir();
+		dir.sort();
+		files_.clear();
+		for (size_t i = 0; i < dir.size(); i++)
+			files_.push_back(dir.getPath(i));
+
+		if (files_.empty()) {
+			printf("replay: no frames in %s\n", path_.c_str());
+			return false;
+		}
+
+		LoadTimestamps();
+
+		// the first frame decides the size and format of the whole sequence
+		cv::Mat first = cv::imread(files_[0], cv::IMREAD_UNCHANGED);
+		if (first.empty()) {
+			printf("replay: cannot read %s\n", files_[0].c_str());
+			return false;
+		}
+		w = first.cols;
+		h = first.rows;
+		AllocatePool((first.channels() == 1) ? GRAY8 : (first.channels() == 3) ? RGB24 : RGBA32);
+		return true;
+	}
+
+	void LoadTimestamps() {
+		// without timestamps assume a steady 60 fps
+		timestamps_.resize(files_.size());
+		for (size_t i = 0; i < files_.size(); i++)
+			timestamps_[i] = i * 1000000 / 60;
+
+		std::ifstream ifs(ofFilePath::join(path_, "timestamps.txt"));
+		uint64_t t;
+		for (size_t i = 0; i < timestamps_.size() && (ifs >> t); i++)
+			timestamps_[i] = t;
+	}
+
+	static bool Decode(const std::string& file, cv::Mat& dst) {
+		cv::Mat img = cv::imread(file, cv::IMREAD_UNCHANGED);
+		if (img.size() != dst.size() || img.type() != dst.type()) {
+			printf("replay: skipping %s, size or format differs from the first frame\n", file.c_str());
+			return false;
+		}
+		img.copyTo(dst);
+		return true;
+	}
+
+	std::string path_;
+	RawRecording recording_;
+	std::vector<std::string> files_;
+	std::vector<uint64_t> timestamps_;
+};
+
+struct SyntheticSceneConfig {
+	int width = 640;
+	int height = 480;
+	int fingers = 10;	// touching at any time
+	float radius = 5;	// sigma of a fingertip in pixels
+	float brightness = 250;	// peak value above the background
+	float background = 20;
+	float noise = 4;	// standard deviation of the sensor noise
+	float speed = 150;	// pixels per second
+	float mergeRate = 0.05f;	// per finger and second: walk onto another finger, then split off
+	float holdTime = 0.5f;	// seconds two merged fingers stay together
+	float lifetime = 5;	// mean seconds between touch-down and lift-off
+	float fps = 120;
+	uint32_t seed = 1;
+	bool realtime = false;
+};
+
+// a finger as rendered, position in camera pixels
+struct SyntheticTouch {
+	int id;
+	float x, y;
+	float age;	// seconds since touch-down
+};
+
+/*
+ Renders IR frames of moving fingertips and keeps the exact touches of
+ every frame, looked up by frame sequence number, as ground truth.
+
+ The scene depends only on the seed and the frame index: the simulation
+ advances one fixed step per frame whether or not a frame was dropped,
+ and the random numbers are drawn from mt19937 without std
+ distributions, whose output differs between standard libraries.
+*/
+class MySyntheticCam : public MyPacedCam
+{
+public:
+	enum { HISTORY = 256 };
+
+	explicit MySyntheticCam(const SyntheticSceneConfig& config)
+		: MyPacedCam(config.width, config.height, config.realtime, false),
+		config_(config),
+		rng_(config.seed),
+		step_(0),
+		nextId_(0) {}
+
+	~MySyntheticCam() { StopThread(); }
+
+	void Start() {
+		AllocatePool(GRAY8);
+
+		// a large table of pre-drawn noise, read at a random offset per frame
+		noise_.resize((size_t)w * h + 4096);
+		for (auto& n : noise_) {
+			const float v = config_.background + config_.noise * Normal();
+			n = (uint8_t)std::min(std::max(v, 0.0f), 255.0f);
+		}
+
+		fingers_.clear();
+		for (int i = 0; i < config_.fingers; i++)
+			fingers_.push_back(Spawn());
+
+		StartThread();
+	}
+
+	// touches rendered into the frame with this sequence number; false once it is
+	// older than the last HISTORY frames
+	bool GetGroundTruth(uint64_t sequence, std::vector<SyntheticTouch>& touches) const {
+		std::lock_guard<std::mutex> guard(truthMutex_);
+		const Truth& truth = truth_[sequence % HISTORY];
+		if (truth.sequence != sequence)
+			return false;
+		touches = truth.touches;
+		return true;
+	}
+
+protected:
+	size_t FrameCount() const { return 0; }
+	uint64_t FrameTime(size_t i) const { return (uint64_t)(i * 1e6 / config_.fps); }
+
+	bool Render(size_t i, FrameRef& frame) {
+		while (step_ < i) {
+			Step(1.0f / config_.fps);
+			step_++;
+		}
+
+		// the noise offset follows the frame index, dropped frames must not shift the random sequence
+		cv::Mat& img = frame->image;
+		const size_t offset = (i * 2654435761u) % 4096;
+		for (int y = 0; y < h; y++)
+			memcpy(img.ptr<uint8_t>(y), &noise_[offset + (size_t)y * w], w);
+
+		for (const auto& f : fingers_)
+			DrawFinger(img, f.x, f.y);
+
+		std::lock_guard<std::mutex> guard(truthMutex_);
+		Truth& truth = truth_[frame->sequence % HISTORY];
+		truth.sequence = frame->sequence;
+		truth.touches.clear();
+		for (const auto& f : fingers_) {
+			SyntheticTouch touch;
+			touch.id = f.id;
+			touch.x = f.x;
+			touch.y = f.y;
+			touch.age = f.age;
+			truth.touches.push_back(touch);
+		}
+		return true;
+	}
+
+private:
+	struct Finger {
+		int id;
+		float x, y;
+		float tx, ty;	// current waypoint
+		float age;
+		float life;
+		int partner;	// id of the finger walked onto, -1 when free
+		float held;	// seconds spent merged
+	};
+
+	struct Truth {
+		uint64_t sequence = 0;
+		std::vector<SyntheticTouch> touches;
+	};
+
+	uint32_t Next() { return (uint32_t)rng_(); }
+	float Uniform() { return (Next() >> 8) * (1.0f / 16777216.0f); }
+	float Uniform(float a, float b) { return a + (b - a) * Uniform(); }
+
+	float Normal() {
+		// Box-Muller
+		const float u = std::max(Uniform(), 1e-7f);
+		const float v = Uniform();
+		return sqrtf(-2 * logf(u)) * cosf(TWO_PI * v);
+	}
+
+	Finger Spawn() {
+		const float margin = 3 * config_.radius;
+		Finger f;
+		f.id = nextId_++;
+		f.x = Uniform(margin, w - margin);
+		f.y = Uniform(margin, h - margin);
+		f.tx = Uniform(margin, w - margin);
+		f.ty = Uniform(margin, h - margin);
+		f.age = 0;
+		f.life = -config_.lifetime * logf(std::max(Uniform(), 1e-7f));
+		f.partner = -1;
+		f.held = 0;
+		return f;
+	}
+
+	const Finger* Find(int id) const {
+		for (const auto& f : fingers_) {
+			if (f.id == id) return &f;
+		}
+		return NULL;
+	}
+
+	void Step(float dt) {
+		const float margin = 3 * config_.radius;
+		for (auto& f : fingers_) {
+			f.age += dt;
+			if (f.age > f.life) {
+				f = Spawn();
+				continue;
+			}
+
+			if (f.partner < 0 && fingers_.size() > 1 && Uniform() < config_.mergeRate * dt) {
+				const Finger& other = fingers_[Next() % fingers_.size()];
+				if (other.id != f.id)
+					f.partner = other.id;
+			}
+
+			if (f.partner >= 0) {
+				const Finger* other = Find(f.partner);
+				if (other == NULL) {
+					f.partner = -1;
+				}
+				else {
+					// follow the partner; once touching, stay a while, then split off
+					f.tx = other->x + config_.radius;
+					f.ty = other->y;
+					if (fabsf(f.x - f.tx) + fabsf(f.y - f.ty) < config_.radius) {
+						f.held += dt;
+						if (f.held > config_.holdTime) {
+							f.partner = -1;
+							f.held = 0;
+							f.tx = Uniform(margin, w - margin);
+							f.ty = Uniform(margin, h - margin);
+						}
+					}
+				}
+			}
+
+			const float dx = f.tx - f.x;
+			const float dy = f.ty - f.y;
+			const float d = sqrtf(dx * dx + dy * dy);
+			// a little faster while chasing, so a finger walking away can be caught
+			const float move = config_.speed * dt * (f.partner >= 0 ? 1.5f : 1.0f);
+			if (d <= move) {
+				f.x = f.tx;
+				f.y = f.ty;
+				if (f.partner < 0) {
+					f.tx = Uniform(margin, w - margin);
+					f.ty = Uniform(margin, h - margin);
+				}
+			}
+			else {
+				f.x += dx / d * move;
+				f.y += dy / d * move;
+			}
+		}
+	}
+
+	// adds a Gaussian spot centred on (cx, cy), pixel (x, y) covering [x, x+1)
+	void DrawFinger(cv::Mat& img, float cx, float cy) const {
+		const float sigma = config_.radius;
+		const int r = (int)ceilf(3 * sigma);
+		const float k = -1.0f / (2 * sigma * sigma);
+		const int x0 = std::max((int)cx - r, 0), x1 = std::min((int)cx + r, w - 1);
+		const int y0 = std::max((int)cy - r, 0), y1 = std::min((int)cy + r, h - 1);
+		for (int y = y0; y <= y1; y++) {
+			uint8_t* row = img.ptr<uint8_t>(y);
+			const float ey = y + 0.5f - cy;
+			for (int x = x0; x <= x1; x++) {
+				const float ex = x + 0.5f - cx;
+				const int v = row[x] + (int)(config_.brightness * expf((ex * ex + ey * ey) * k));
+				row[x] = (uint8_t)std::min(v, 255);
+			}
+		}
+	}
+
+	SyntheticSceneConfig config_;
+	std::mt19937 rng_;
+	size_t step_;
+	int nextId_;
+	std::vector<Finger> fingers_;
+	std::vector<uint8_t> noise_;
+
+	mutable std::mutex truthMutex_;
+	Truth truth_[HISTORY];
+};
+
+/*
+ Passes another camera's frames through unchanged and, while recording,
+ queues a reference to each one for RawRecorder. The capture thread never
+ waits on the disk. Owns the source.
+*/
+class MyRecordingCam : public MyCamBase
+{
+public:
+	explicit MyRecordingCam(MyCamBase* source) : MyCamBase(0, 0), source_(source) {
+		source_->ReservePoolSlots(RawRecorder::QUEUE_SIZE);
+	}
+
+	~MyRecordingCam() {
+		StopRecording();
+		delete source_;
+	}
+
+	void Start() {
+		source_->Start();
+		w = source_->GetWidth();
+		h = source_->GetHeight();
+		format_ = source_->GetPixelFormat();
+	}
+
+	void Stop() {
+		StopRecording();
+		source_->Stop();
+	}
+
+	void Grab(std::function<void(FrameRef)> func) {
+		source_->Grab([this, &func](FrameRef frame) {
+			{
+				std::lock_guard<std::mutex> guard(recorderMutex_);
+				recorder_.Push(frame);
+			}
+			func(std::move(frame));
+			});
+	}
+
+	void SetExposure(int exposure) { source_->SetExposure(exposure); }
+	bool WaitFrame(std::chrono::milliseconds timeout) { return source_->WaitFrame(timeout); }
+	bool IsLive() const { return source_->IsLive(); }
+	uint64_t GetDroppedFrames() const { return source_->GetDroppedFrames(); }
+
+	MyCamBase* GetSource() const { return source_; }
+
+	// header carries calibration and params, size and format are taken from the source
+	bool StartRecording(const std::string& path, RawRecordingHeader header, uint32_t capacity) {
+		header.width = w;
+		header.height = h;
+		header.format = format_;
+		header.channels = rawrecording::FORMAT_CHANNELS[format_];
+
+		std::lock_guard<std::mutex> guard(recorderMutex_);
+		return recorder_.Open(path, header, capacity);
+	}
+
+	void StopRecording() {
+		std::lock_guard<std::mutex> guard(recorderMutex_);
+		recorder_.Close();
+	}
+
+	bool IsRecording() const { return recorder_.IsOpen(); }
+
+	// frames written so far and frames the recorder could not keep up with
+	uint64_t GetRecordedFrames() const { return recorder_.GetWritten(); }
+	uint64_t GetRecorderDrops() const { return recorder_.GetDropped(); }
+
+private:
+	MyCamBase* source_;
+	RawRecorder recorder_;
+	std::mutex recorderMutex_;
+};
+
+#ifdef TARGET_WIN32
 class MyWebCam : public MyCamBase
 {
 public:
-	MyWebCam(int w, int h) : MyCamBase(w, h) {}
+	MyWebCam(int w, int h, int device = 0) : MyCamBase(w, h), deviceId(device) {}
 
 	void Start() {
 		VI.setupDevice(deviceId, w, h);
 		w = VI.getWidth(deviceId);
 		h = VI.getHeight(deviceId);
-		pixels_.allocate(w, h, 4);
+		AllocatePool(RGB24);
 
 		//// Range for video setting 4: Min:0 Max:6 SteppingDelta:1 Default:2 Flags:2
 		//long lmin, lmax, lsd, lc, lf, ldv;
@@ -37,17 +725,40 @@ public:
 		VI.stopDevice(deviceId);
 	}
 
-	void Grab(std::function<void(cv::Mat)> func) {
-		if (VI.isFrameNew(deviceId))
-		{
-			pixels_.setFromPixels(VI.getPixels(deviceId, true, false), w, h, OF_IMAGE_COLOR);
-			func(ofxCv::toCv(pixels_));
+	void Grab(std::function<void(FrameRef)> func) {
+		if (!frameReady_) {
+			if (!VI.isFrameNew(deviceId))
+				return;
+			StampArrival();
 		}
+
+		frameReady_ = false;
+		FrameRef frame = AcquireFrame();
+		if (frame && VI.getPixels(deviceId, frame->image.data, true, false))
+			func(frame);
+	}
+
+	// videoInput keeps its DirectShow frame event private, so the best we can
+	// do is a fine-grained check of isFrameNew (which also clears the flag)
+	bool WaitFrame(std::chrono::milliseconds timeout) {
+		auto until = std::chrono::steady_clock::now() + timeout;
+		while (!frameReady_) {
+			if (VI.isFrameNew(deviceId)) {
+				StampArrival();
+				frameReady_ = true;
+				break;
+			}
+			if (std::chrono::steady_clock::now() >= until)
+				break;
+			std::this_thread::sleep_for(std::chrono::microseconds(250));
+		}
+		return frameReady_;
 	}
 
 private:
 	videoInput VI;
-	int deviceId = 0;
+	int deviceId;
+	bool frameReady_ = false;
 };
 
 // OptiCam
@@ -56,7 +767,8 @@ using namespace CameraLibrary;
 class MyOptiCam : public MyCamBase
 {
 public:
-	MyOptiCam(int w, int h) : MyCamBase(w, h) {}
+	// index into the SDK's camera list, -1 for whichever it hands out first
+	MyOptiCam(int w, int h, int index = -1) : MyCamBase(w, h), index_(index), listener_(this) {}
 
 	void Start()
 	{
@@ -74,14 +786,22 @@ public:
 		if (list.Count() == 0)
 			printf("None\n");
 
-		camera = CameraManager::X().GetCamera();
+		camera = (index_ >= 0 && index_ < list.Count())
+			? CameraManager::X().GetCamera(list[index_].UID())
+			: CameraManager::X().GetCamera();
 		w = camera->Width();
 		h = camera->Height();
 
-		pixels_.allocate(w, h, 4);
-		framebuffer = std::make_unique<Bitmap>(w, h, 0, Bitmap::ThirtyTwoBit, pixels_.getData());
+		// the camera only delivers IR intensity, so rasterize 8-bit gray
+		// straight into the pool, one Bitmap per slot
+		AllocatePool(GRAY8);
+		framebuffers_.clear();
+		for (int i = 0; i < pool_.Size(); i++) {
+			framebuffers_.push_back(std::make_unique<Bitmap>(w, h, (int)pool_.Slot(i).image.step, Bitmap::EightBit, pool_.Slot(i).image.data));
+		}
 
 		camera->SetVideoType(Core::MJPEGMode);
+		camera->AttachListener(&listener_);
 		camera->Start();
 		camera->SetTextOverlay(false);
 		camera->SetIntensity(15);
@@ -90,9 +810,10 @@ public:
 
 	void Stop() {
 		camera->Stop();
+		camera->DetachListener(&listener_);
 	}
 
-	void Grab(std::function<void(cv::Mat)> func) {
+	void Grab(std::function<void(FrameRef)> func) {
 		Frame* frame = NULL;
 		Frame* latestFrame = camera->GetFrame();
 
@@ -106,9 +827,14 @@ public:
 		}
 
 		if (frame) {
-			frame->Rasterize(framebuffer.get());
-			func(ofxCv::toCv(pixels_));
+			FrameRef image = AcquireFrame();
+			if (image) {
+				frame->Rasterize(framebuffers_[image->index].get());
+			}
 			frame->Release();
+
+			if (image)
+				func(image);
 		}
 	}
 
@@ -123,6 +849,20 @@ public:
 	}
 
 private:
+	// the SDK calls FrameAvailable from its own thread as soon as a frame is queued
+	class FrameListener : public cCameraListener
+	{
+	public:
+		FrameListener(MyOptiCam* owner) : owner_(owner) {}
+		void FrameAvailable() { owner_->NotifyFrame(); }
+
+	private:
+		MyOptiCam* owner_;
+	};
+
+	int index_;
+	FrameListener listener_;
 	CameraLibrary::Camera* camera = NULL;
-	std::unique_ptr<CameraLibrary::Bitmap> framebuffer = NULL;
-};
\ No newline at end of file
+	std::vector<std::unique_ptr<CameraLibrary::Bitmap> > framebuffers_;
+};
+#endif // TARGET_WIN32
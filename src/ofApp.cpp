@@ -7,23 +7,69 @@ void ofApp::setup() {
 	gui_.add(trackerThreshold_.setup("tracker threshold", 240, 0, 255));
 	gui_.add(trackerMinAreaRadius_.setup("tracker min radius", 10, 1, 100));
 	gui_.add(trackerMaxAreaRadius_.setup("tracker max radius", 50, 1, 300));
+	gui_.add(predictionOffset_.setup("prediction offset ms", 0, 0, 50));
+	gui_.add(maxPrediction_.setup("max prediction ms", 50, 0, 100));
+	gui_.add(gamma_.setup("gamma", 10, 1, 20));
+	gui_.add(blurRadius_.setup("blur radius", 4, 0, 4));
+	gui_.add(backgroundRate_.setup("background rate (0 off)", 0, 0, 7));
+	gui_.add(backgroundInterval_.setup("background interval", 4, 1, 30));
+	gui_.add(changeThreshold_.setup("change threshold (0 off)", 0, 0, 10));
+	gui_.add(debugContours_.setup("draw contours", false));
+	gui_.add(drawTrails_.setup("draw trails", true));
+	gui_.add(latencyOverlay_.setup("latency overlay", false));
 
 	fingerTracker_ = std::make_unique<FingerTracker>();
 
 	loadParam();
+	fingerTracker_->SetTuioOutput(tuio_);
+	if (!fingerTracker_->SetSharedTouchOutput(sharedTouches_))
+		printf("cannot create shared touch ring %s\n", sharedTouches_.c_str());
+
+	// every source goes through the recorder, recording is toggled with 'c'
+	cameras_.push_back(new MyRecordingCam(createCamera(cameraSource_, cameraIndex_, replayPath_)));
+	for (auto& setup : extraCameras_)
+		cameras_.push_back(new MyRecordingCam(createCamera(setup.source, setup.index, setup.replayPath)));
+	for (size_t i = 0; i < cameras_.size(); i++)
+		fingerTracker_->StartInputCamera(cameras_[i], i);
+
+	// a raw recording brings the calibration and parameters it was taken with
+	auto replay = dynamic_cast<MyReplayCam*>(cameras_[0]->GetSource());
+	if (replay != NULL && replay->GetRecording() != NULL) {
+		auto params = nlohmann::json::parse(replay->GetRecording()->Header().params, nullptr, false);
+		if (!params.is_discarded())
+			applyParam(params);
+	}
 
-	auto inpCam = new MyOptiCam(640, 480);
-	//auto inpCam = new MyWebCam(640, 480);
+	// scored against the first camera, which sits at the table origin
+	auto synthetic = dynamic_cast<MySyntheticCam*>(cameras_[0]->GetSource());
+	if (synthetic != NULL) {
+		score_ = std::make_unique<TrackingScore>(synthetic);
+		score_->SetMapping(fingerTracker_->GetPerspective(), fingerTracker_->GetCameraSize(), fingerTracker_->GetProcSize());
+		TrackingScore* score = score_.get();
+		fingerTracker_->SetOutputListener([score](const TrackerFrame& frame) { score->Score(frame); });
+	}
 
-	fingerTracker_->StartInputCamera(inpCam);
 	fingerTracker_->startThread(true);
-	colorImg.allocate(640, 480, OF_IMAGE_COLOR);
+	colorImg.allocate(cameras_[0]->GetWidth(), cameras_[0]->GetHeight(), OF_IMAGE_COLOR);
 }
 
 void ofApp::update()
 {
-	fingerTracker_->SetCameraExposure(exposure_);
-	fingerTracker_->SetFinderParam(trackerThreshold_, trackerMinAreaRadius_, trackerMaxAreaRadius_);
+	TrackerParams params;
+	params.exposure = exposure_;
+	params.threshold = trackerThreshold_;
+	params.minAreaRadius = trackerMinAreaRadius_;
+	params.maxAreaRadius = trackerMaxAreaRadius_;
+	params.predictionOffset = predictionOffset_ / 1000.0f;
+	params.maxPrediction = maxPrediction_ / 1000.0f;
+	params.gamma = gamma_;
+	params.blurRadius = blurRadius_;
+	params.backgroundRate = backgroundRate_;
+	params.backgroundInterval = backgroundInterval_;
+	params.changeThreshold = changeThreshold_;
+	fingerTracker_->SetParams(params);
+	fingerTracker_->SetDebugContours(debugContours_);
+	fingerTracker_->SetTrailEnabled(drawTrails_);
 }
 
 //--------------------------------------------------------------
@@ -31,8 +77,8 @@ void ofApp::draw() {
 	ofSetBackgroundColor(50, 10, 10);
 	ofSetColor(255);
 
-	fingerTracker_->GetImage(colorImg);
-	colorImg.update();
+	if (fingerTracker_->GetImage(colorImg))
+		colorImg.update();
 	colorImg.draw(0, 0);
 
 	fingerTracker_->draw();
@@ -41,13 +87,60 @@ void ofApp::draw() {
 	ofSetColor(0, 0, 255);
 	auto msg = "fps: " + ofToString(ofGetFrameRate(), 0);
 	ofDrawBitmapString(msg, 500, 20);
+	msg = "latency: " + ofToString(fingerTracker_->GetLatency() * 1000, 1) + " ms";
+	ofDrawBitmapString(msg, 500, 35);
+	if (latencyOverlay_)
+		fingerTracker_->DrawLatencyStats(320, 60);
+	if (cameras_[0]->IsRecording()) {
+		uint64_t frames = 0, drops = 0;
+		for (auto camera : cameras_) {
+			frames += camera->GetRecordedFrames();
+			drops += camera->GetRecorderDrops();
+		}
+		ofSetColor(255, 0, 0);
+		msg = "REC " + ofToString(frames) + " frames, " + ofToString(drops) + " dropped";
+		ofDrawBitmapString(msg, 500, 50);
+	}
+	// only receivers that fall behind are worth a line
+	int y = 65;
+	if (cameras_.size() > 1) {
+		ofSetColor(0, 0, 255);
+		msg = "camera " + ofToString(fingerTracker_->SelectedChannel() + 1) + "/" + ofToString(cameras_.size());
+		ofDrawBitmapString(msg, 500, y);
+		y += 15;
+	}
+	for (auto& tuio : fingerTracker_->GetTuioStats()) {
+		if (tuio.dropped == 0) continue;
+		ofSetColor(255, 0, 0);
+		msg = "tuio " + tuio.destination.host + ":" + ofToString(tuio.destination.port) + " dropped " + ofToString(tuio.dropped) + " of " + ofToString(tuio.sent + tuio.dropped);
+		ofDrawBitmapString(msg, 500, y);
+		y += 15;
+	}
+	if (score_) {
+		auto stats = score_->Stats();
+		ofSetColor(255, 255, 0);
+		msg = "score: " + ofToString(stats.matched) + "/" + ofToString(stats.truth) + " matched, "
+			+ ofToString(stats.missed) + " missed, " + ofToString(stats.falsePositives) + " false, "
+			+ ofToString(stats.idSwitches) + " id switches, error " + ofToString(stats.meanError, 2)
+			+ " px, " + ofToString(stats.fps, 0) + " fps";
+		ofDrawBitmapString(msg, 10, 470);
+	}
 
 	// draw GUI
 	gui_.draw();
 }
 
 void ofApp::exit() {
-	fingerTracker_->stopThread();
+	// joins the tracker's own stages, every channel's threads and the TUIO senders
+	fingerTracker_->waitForThread(true);
+
+	// nothing holds a frame any more, the cameras and their pools can go
+	score_.reset();
+	for (auto camera : cameras_) {
+		camera->Stop();
+		delete camera;
+	}
+	cameras_.clear();
 }
 
 //--------------------------------------------------------------
@@ -62,14 +155,152 @@ void ofApp::keyPressed(int key) {
 		saveParam();
 
 	}
+	else if (key == 'r') {
+		fingerTracker_->ResetLatencyStats();
+		if (score_)
+			score_->Reset();
+	}
+	else if (key == 'b') {
+		fingerTracker_->ResetBackground();
+	}
+	else if (key == 'n') {
+		// next camera to show and calibrate
+		fingerTracker_->SelectChannel((fingerTracker_->SelectedChannel() + 1) % cameras_.size());
+	}
+	else if (key == 'c') {
+		if (cameras_[0]->IsRecording()) {
+			for (auto camera : cameras_)
+				camera->StopRecording();
+		}
+		else {
+			// one file per camera, each with its own calibration
+			const std::string stamp = ofGetTimestampString();
+			std::string params = makeParam().dump();
+			for (size_t c = 0; c < cameras_.size(); c++) {
+				RawRecordingHeader header = {};
+				cv::Mat pm;
+				fingerTracker_->GetPerspective(c).convertTo(pm, CV_64F);
+				for (int i = 0; i < 9; i++)
+					header.pm[i] = pm.ptr<double>(0)[i];
+				const auto& rect = fingerTracker_->GetCalibRect(c);
+				for (size_t i = 0; i < 4; i++) {
+					header.rect[i * 2] = rect[i].x;
+					header.rect[i * 2 + 1] = rect[i].y;
+				}
+				strncpy(header.params, params.c_str(), sizeof(header.params) - 1);
+
+				auto name = (cameras_.size() > 1) ? "recording-" + stamp + "-cam" + ofToString(c) : "recording-" + stamp;
+				auto path = ofToDataPath(name + ".raw");
+				if (!cameras_[c]->StartRecording(path, header, recordFrames_))
+					printf("cannot record to %s\n", path.c_str());
+			}
+		}
+	}
+}
+
+// "camera": { "source": "opti" | "webcam" | "replay" | "synthetic", "index", "width", "height", "replayPath", "replayRealtime",
+//             "replayLoop", "synthetic": { "fingers", "radius", "noise", "speed", "mergeRate", "seed", "realtime", ... } }
+// width and height are requested from live cameras, the tracker follows whatever they deliver
+MyCamBase* ofApp::createCamera(const std::string& source, int index, const std::string& replayPath) {
+#ifdef TARGET_WIN32
+	if (source == "opti")
+		return new MyOptiCam(cameraWidth_, cameraHeight_, index);
+	if (source == "webcam")
+		return new MyWebCam(cameraWidth_, cameraHeight_, index);
+#endif
+	if (source == "synthetic")
+		return new MySyntheticCam(synthetic_);
+	if (source != "replay")
+		printf("camera source %s is not available, replaying %s\n", source.c_str(), replayPath.c_str());
+	return new MyReplayCam(ofToDataPath(replayPath), replayRealtime_, replayLoop_);
 }
 
 void ofApp::loadParam() {
 	nlohmann::json j;
 	std::ifstream ifs("data.json");
+	if (!ifs.is_open())
+		return;
 	ifs >> j;
 	ifs.close();
 
+	// older settings have no "camera" object, the defaults stay in place
+	if (j.contains("camera")) {
+		auto& camera = j["camera"];
+		cameraSource_ = camera.value("source", cameraSource_);
+		cameraIndex_ = camera.value("index", cameraIndex_);
+		cameraWidth_ = camera.value("width", cameraWidth_);
+		cameraHeight_ = camera.value("height", cameraHeight_);
+		replayPath_ = camera.value("replayPath", replayPath_);
+		replayRealtime_ = camera.value("replayRealtime", replayRealtime_);
+		replayLoop_ = camera.value("replayLoop", replayLoop_);
+		recordFrames_ = camera.value("recordFrames", recordFrames_);
+
+		auto synthetic = camera.value("synthetic", nlohmann::json::object());
+		synthetic_.width = synthetic.value("width", synthetic_.width);
+		synthetic_.height = synthetic.value("height", synthetic_.height);
+		synthetic_.fingers = synthetic.value("fingers", synthetic_.fingers);
+		synthetic_.radius = synthetic.value("radius", synthetic_.radius);
+		synthetic_.brightness = synthetic.value("brightness", synthetic_.brightness);
+		synthetic_.background = synthetic.value("background", synthetic_.background);
+		synthetic_.noise = synthetic.value("noise", synthetic_.noise);
+		synthetic_.speed = synthetic.value("speed", synthetic_.speed);
+		synthetic_.mergeRate = synthetic.value("mergeRate", synthetic_.mergeRate);
+		synthetic_.holdTime = synthetic.value("holdTime", synthetic_.holdTime);
+		synthetic_.lifetime = synthetic.value("lifetime", synthetic_.lifetime);
+		synthetic_.fps = synthetic.value("fps", synthetic_.fps);
+		synthetic_.seed = synthetic.value("seed", synthetic_.seed);
+		synthetic_.realtime = synthetic.value("realtime", synthetic_.realtime);
+	}
+
+	// "tuio": { "mode": "legacy" | "bundled", "destinations": [ { "host", "port" } ], "mtu", "epsilon", "refresh" }
+	auto tuio = j.value("tuio", nlohmann::json::object());
+	tuio_.bundled = (tuio.value("mode", std::string("legacy")) == "bundled");
+	if (tuio.contains("destinations")) {
+		tuio_.destinations.clear();
+		for (auto& d : tuio["destinations"])
+			tuio_.destinations.push_back({ d.value("host", std::string("127.0.0.1")), d.value("port", 3333) });
+	}
+	tuio_.encoder.mtu = tuio.value("mtu", tuio_.encoder.mtu);
+	tuio_.encoder.epsilon = tuio.value("epsilon", tuio_.encoder.epsilon);
+	tuio_.encoder.refresh = tuio.value("refresh", tuio_.encoder.refresh);
+
+	// "sharedTouches": "ofTracker-touches" for local readers of touchRing.h, "" for none
+	sharedTouches_ = j.value("sharedTouches", sharedTouches_);
+
+	// "tracker": { "processScale", "pyramidLevels", "refineMargin" }, fixed for the run
+	if (j.contains("tracker")) {
+		resolution_.processScale = j["tracker"].value("processScale", resolution_.processScale);
+		resolution_.pyramidLevels = j["tracker"].value("pyramidLevels", resolution_.pyramidLevels);
+		resolution_.refineMargin = j["tracker"].value("refineMargin", resolution_.refineMargin);
+	}
+	fingerTracker_->SetResolution(resolution_);
+
+	// "cameras": [ { "source", "index", "replayPath", "offset": [x, y], "rect" } ], cameras next to the one
+	// in "camera", which sits at the table origin; each has its own calibration and is placed by offset
+	extraCameras_.clear();
+	for (auto& c : j.value("cameras", nlohmann::json::array())) {
+		CameraSetup setup;
+		setup.source = c.value("source", cameraSource_);
+		setup.index = c.value("index", 0);
+		setup.replayPath = c.value("replayPath", replayPath_);
+		auto offset = c.value("offset", std::vector<int>{ 0, 0 });
+		setup.offset = (offset.size() == 2) ? cv::Point(offset[0], offset[1]) : cv::Point(0, 0);
+
+		const int channel = fingerTracker_->AddChannel(setup.offset);
+		if (c.contains("rect")) {
+			std::vector<ofVec2f> rect;
+			for (size_t i = 0; i < 4; ++i)
+				rect.push_back(ofVec2f(c["rect"][i * 2], c["rect"][i * 2 + 1]));
+			fingerTracker_->SetPerspective(rect, channel);
+		}
+		extraCameras_.push_back(setup);
+	}
+
+	applyParam(j);
+}
+
+// calibration and tracking parameters, shared by data.json and raw recordings
+void ofApp::applyParam(nlohmann::json j) {
 	std::vector<ofVec2f> rect;
 	for (size_t i = 0; i < 4; ++i)
 	{
@@ -77,18 +308,75 @@ void ofApp::loadParam() {
 	}
 	fingerTracker_->SetPerspective(rect);
 
-	exposure_ = j["camera"]["exposure"];
+	if (j.contains("camera"))
+		exposure_ = j["camera"].value("exposure", (int)exposure_);
 	trackerMaxAreaRadius_ = j["tracker"]["maxAreaRadius"];
 	trackerMinAreaRadius_ = j["tracker"]["minAreaRadius"];
 	trackerThreshold_ = j["tracker"]["threshold"];
+	predictionOffset_ = j["tracker"].value("predictionOffset", 0.0f);
+	maxPrediction_ = j["tracker"].value("maxPrediction", 50.0f);
+	gamma_ = j["tracker"].value("gamma", 10.0f);
+	blurRadius_ = j["tracker"].value("blurRadius", 4);
+	backgroundRate_ = j["tracker"].value("backgroundRate", 0);
+	backgroundInterval_ = j["tracker"].value("backgroundInterval", 4);
+	changeThreshold_ = j["tracker"].value("changeThreshold", 0.0f);
+	drawTrails_ = j["tracker"].value("trails", true);
 }
 
 void ofApp::saveParam() {
+	nlohmann::json j = makeParam();
+	j["camera"]["source"] = cameraSource_;
+	j["camera"]["index"] = cameraIndex_;
+	j["camera"]["width"] = cameraWidth_;
+	j["camera"]["height"] = cameraHeight_;
+	j["camera"]["replayPath"] = replayPath_;
+	j["camera"]["replayRealtime"] = replayRealtime_;
+	j["camera"]["replayLoop"] = replayLoop_;
+	j["camera"]["recordFrames"] = recordFrames_;
+	j["camera"]["synthetic"] = {
+		{ "width", synthetic_.width }, { "height", synthetic_.height },
+		{ "fingers", synthetic_.fingers }, { "radius", synthetic_.radius },
+		{ "brightness", synthetic_.brightness }, { "background", synthetic_.background },
+		{ "noise", synthetic_.noise }, { "speed", synthetic_.speed },
+		{ "mergeRate", synthetic_.mergeRate }, { "holdTime", synthetic_.holdTime },
+		{ "lifetime", synthetic_.lifetime }, { "fps", synthetic_.fps },
+		{ "seed", synthetic_.seed }, { "realtime", synthetic_.realtime }
+	};
+	j["tuio"]["mode"] = tuio_.bundled ? "bundled" : "legacy";
+	j["tuio"]["destinations"] = nlohmann::json::array();
+	for (auto& d : tuio_.destinations)
+		j["tuio"]["destinations"].push_back({ { "host", d.host }, { "port", d.port } });
+	j["tuio"]["mtu"] = tuio_.encoder.mtu;
+	j["tuio"]["epsilon"] = tuio_.encoder.epsilon;
+	j["tuio"]["refresh"] = tuio_.encoder.refresh;
+	j["sharedTouches"] = sharedTouches_;
+	j["tracker"]["processScale"] = resolution_.processScale;
+	j["tracker"]["pyramidLevels"] = resolution_.pyramidLevels;
+	j["tracker"]["refineMargin"] = resolution_.refineMargin;
+	for (size_t c = 0; c < extraCameras_.size(); c++) {
+		const CameraSetup& setup = extraCameras_[c];
+		std::array<float, 8> rect;
+		const auto& points = fingerTracker_->GetCalibRect(c + 1);
+		for (size_t i = 0; i < 4; ++i) {
+			rect[i * 2] = points[i].x;
+			rect[i * 2 + 1] = points[i].y;
+		}
+		j["cameras"].push_back({
+			{ "source", setup.source }, { "index", setup.index }, { "replayPath", setup.replayPath },
+			{ "offset", { setup.offset.x, setup.offset.y } }, { "rect", rect } });
+	}
+
+	std::ofstream ofs("data.json");
+	ofs << j.dump(4) << std::endl;
+	ofs.close();
+}
+
+nlohmann::json ofApp::makeParam() {
 	nlohmann::json j;
 	std::array<float, 8> rect;
 	for (size_t i = 0; i < 4; ++i)
 	{
-		auto p = fingerTracker_->pts_src[i];
+		auto p = fingerTracker_->GetCalibRect()[i];
 		rect[i*2] = p.x;
 		rect[i*2 + 1] = p.y;
 	}
@@ -97,10 +385,15 @@ void ofApp::saveParam() {
 	j["tracker"]["maxAreaRadius"] = (float)this->trackerMaxAreaRadius_;
 	j["tracker"]["minAreaRadius"] = (float)this->trackerMinAreaRadius_;
 	j["tracker"]["threshold"] = (float)this->trackerThreshold_;
-
-	std::ofstream ofs("data.json");
-	ofs << j.dump(4) << std::endl;
-	ofs.close();
+	j["tracker"]["predictionOffset"] = (float)this->predictionOffset_;
+	j["tracker"]["maxPrediction"] = (float)this->maxPrediction_;
+	j["tracker"]["gamma"] = (float)this->gamma_;
+	j["tracker"]["blurRadius"] = (int)this->blurRadius_;
+	j["tracker"]["backgroundRate"] = (int)this->backgroundRate_;
+	j["tracker"]["backgroundInterval"] = (int)this->backgroundInterval_;
+	j["tracker"]["changeThreshold"] = (float)this->changeThreshold_;
+	j["tracker"]["trails"] = (bool)this->drawTrails_;
+	return j;
 }
 
 //--------------------------------------------------------------
@@ -129,6 +422,8 @@ void ofApp::mousePressed(int x, int y, int button){
 void ofApp::mouseReleased(int x, int y, int button) {
 	if (fingerTracker_->IsCalibMode()) {
 		fingerTracker_->SetCalib();
+		if (score_ && fingerTracker_->SelectedChannel() == 0)
+			score_->SetMapping(fingerTracker_->GetPerspective(), fingerTracker_->GetCameraSize(), fingerTracker_->GetProcSize());
 	}
 }
 
@@ -10,9 +10,24 @@
  // TUIO 1.1
 #include "TuioServer.h"
 #include "osc/OscTypes.h"
+#include "ip/UdpSocket.h"
 
+#include "framePool.h"
+#include "spscRing.h"
+#include "rawRecording.h"
 #include "mycamera.h"
+#include "photometric.h"
+#include "blobDetector.h"
+#include "spatialTracker.h"
+#include "tripleBuffer.h"
+#include "paramBlock.h"
+#include "latencyHistogram.h"
+#include "tuioEncoder.h"
+#include "tuioSender.h"
+#include "touchRing.h"
+#include "cameraChannel.h"
 #include "fingerTracker.h"
+#include "trackingScore.h"
 
 class ofApp : public ofBaseApp {
 public:
@@ -42,11 +57,57 @@ public:
 	ofxFloatSlider trackerThreshold_;
 	ofxFloatSlider trackerMinAreaRadius_;
 	ofxFloatSlider trackerMaxAreaRadius_;
+	ofxFloatSlider predictionOffset_;
+	ofxFloatSlider maxPrediction_;
+	ofxFloatSlider gamma_;
+	ofxIntSlider blurRadius_;
+	ofxIntSlider backgroundRate_;
+	ofxIntSlider backgroundInterval_;
+	ofxFloatSlider changeThreshold_;
+	ofxToggle debugContours_;
+	ofxToggle drawTrails_;	// off for headless runs, the followers then keep no trail
+	ofxToggle latencyOverlay_;
 	ofxPanel gui_;
 
 	std::unique_ptr<FingerTracker> fingerTracker_;
 
+	// a camera next to the first one, "cameras" in data.json
+	struct CameraSetup {
+		std::string source;
+		int index;	// device on this host, for "opti" and "webcam"
+		std::string replayPath;
+		cv::Point offset;	// of its warped image on the table, in tracker pixels
+	};
+
+	// input, selected in data.json
+#ifdef TARGET_WIN32
+	std::string cameraSource_ = "opti";
+#else
+	std::string cameraSource_ = "replay";
+#endif
+	int cameraIndex_ = 0;
+	int cameraWidth_ = 640;	// requested from live cameras
+	int cameraHeight_ = 480;
+	std::string replayPath_ = "replay";
+	bool replayRealtime_ = true;
+	bool replayLoop_ = false;
+	uint32_t recordFrames_ = 2400;	// 10 seconds at 240 fps
+	SyntheticSceneConfig synthetic_;
+	std::vector<CameraSetup> extraCameras_;
+	MyCamBase* createCamera(const std::string& source, int index, const std::string& replayPath);
+	std::vector<MyRecordingCam*> cameras_;	// one per tracker channel, in channel order
+	TrackerResolution resolution_;	// "tracker" in data.json, before the cameras start
+
+	// output, "tuio" in data.json
+	TuioOutputConfig tuio_;
+	std::string sharedTouches_;	// shared memory ring name, empty for none
+
+	// set when the input is synthetic and the tracker can be scored against ground truth
+	std::unique_ptr<TrackingScore> score_;
+
 	// json
 	void saveParam();
 	void loadParam();
+	void applyParam(nlohmann::json j);
+	nlohmann::json makeParam();
 };
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <thread>
+#include <type_traits>
+
+/*
+ Seqlock-protected copy of a plain parameter struct.
+
+ One writer publishes whole blocks, any number of readers poll with the
+ version they last saw. A reader whose version is current returns after a
+ single atomic load, otherwise it copies the block without ever taking a
+ lock, retrying only if it raced with a publish.
+*/
+template <class T>
+class ParamBlock
+{
+	static_assert(std::is_trivially_copyable<T>::value, "ParamBlock needs a trivially copyable type");
+	enum { WORDS = (sizeof(T) + sizeof(uint32_t) - 1) / sizeof(uint32_t) };
+
+public:
+	ParamBlock() : version_(0) {
+		for (int i = 0; i < WORDS; i++)
+			data_[i].store(0, std::memory_order_relaxed);
+	}
+
+	// writer side, not safe to call from more than one thread at a time
+	void Publish(const T& value) {
+		uint32_t words[WORDS] = {};
+		memcpy(words, &value, sizeof(T));
+
+		const uint64_t version = version_.load(std::memory_order_relaxed);
+		version_.store(version + 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+		for (int i = 0; i < WORDS; i++)
+			data_[i].store(words[i], std::memory_order_relaxed);
+		version_.store(version + 2, std::memory_order_release);
+	}
+
+	// Copies the block into value when it changed since version and updates
+	// version. Returns false, without touching value, when nothing changed.
+	bool Read(T& value, uint64_t& version) const {
+		for (;;) {
+			const uint64_t before = version_.load(std::memory_order_acquire);
+			if (before == version)
+				return false;
+			if (before & 1) {
+				std::this_thread::yield();
+				continue;
+			}
+
+			uint32_t words[WORDS];
+			for (int i = 0; i < WORDS; i++)
+				words[i] = data_[i].load(std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_acquire);
+
+			if (version_.load(std::memory_order_relaxed) == before) {
+				memcpy(&value, words, sizeof(T));
+				version = before;
+				return true;
+			}
+		}
+	}
+
+	uint64_t Version() const { return version_.load(std::memory_order_acquire); }
+
+private:
+	std::atomic<uint64_t> version_;
+	std::atomic<uint32_t> data_[WORDS];
+};
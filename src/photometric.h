@@ -0,0 +1,577 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+
+#if defined(_M_X64) || defined(__SSE2__)
+#include <emmintrin.h>
+#define PHOTOMETRIC_SSE2 1
+#endif
+
+/*
+ Fused preprocessing for the tracker: remap gather + channel pick,
+ background subtraction, separable integer blur (up to 9 taps) and gamma
+ LUT in a single pass.
+
+ Output rows are produced one at a time from a ring of 9 horizontally
+ blurred rows, so the intermediate data never leaves L1 and the source
+ frame is only read at the pixels the remap actually needs.
+
+ The background is a running average of the gathered pixels, kept by the
+ caller as CV_16SC1 with 7 fractional bits so that the update
+ bg += (x - bg) / 2^shift stays within 16-bit lanes. It is subtracted
+ before the blur, learned only every few frames and not at all under
+ frozen rectangles, so fingers resting on the table stay foreground.
+
+ With a change threshold set, the output is split into TILE x TILE tiles.
+ Each tile's gathered pixels are compared (SAD) against those it was last
+ processed from; only tiles that changed, and their neighbours the blur
+ reaches into, are blurred again, the others keep last frame's result.
+ This is an approximation of the full pass: a tile may differ from it by
+ up to the threshold's worth of change, blurred, and its background
+ subtraction may lag. One row of tiles is refreshed per frame regardless,
+ so no tile is more than TileRows() frames stale.
+
+ With reduce levels, every output pixel is the mean of a 2^levels square
+ of map pixels, a box-filtered pyramid level of the warp rather than a
+ sparser sampling of the camera. The offset table always covers the whole
+ map, so processing windows (ROIs) of one map reuses it.
+*/
+class PhotometricKernel
+{
+public:
+	enum { RADIUS = 4, TAPS = RADIUS * 2 + 1, TILE = 16 };
+
+	PhotometricKernel()
+		: gamma_(-1),
+		channel_(0),
+		radius_(-1),
+		bgShift_(0),
+		bgInterval_(1),
+		bgFrame_(0),
+		bgReset_(true),
+		freezeDirty_(true),
+		changeThreshold_(0),
+		tileCols_(0),
+		tileRows_(0),
+		refreshRow_(0),
+		fullRefresh_(true),
+		srcCols_(0),
+		srcRows_(0),
+		srcStep_(0),
+		srcChannels_(0),
+		srcChannel_(0),
+		reduceLevels_(0),
+		offsetsOrigin_(0),
+		offsetsStride_(0)
+	{
+		SetBlurRadius(RADIUS);
+		SetGamma(1.0);
+	}
+
+	// 0..RADIUS, same kernel as cv::GaussianBlur(Size(2r+1, 2r+1), 0) in 8-bit fixed point
+	void SetBlurRadius(int radius) {
+		radius = std::min(std::max(radius, 0), (int)RADIUS);
+		if (radius == radius_) return;
+		radius_ = radius;
+		fullRefresh_ = true;
+		taps_ = radius * 2 + 1;
+
+		const double sigma = 0.3 * ((taps_ - 1) * 0.5 - 1) + 0.8;
+		double w[TAPS], sum = 0;
+		for (int i = 0; i < taps_; i++) {
+			w[i] = exp(-(i - radius) * (i - radius) / (2 * sigma * sigma));
+			sum += w[i];
+		}
+		int total = 0;
+		for (int i = 0; i < taps_; i++) {
+			weights_[i] = (uint16_t)floor(w[i] / sum * 256 + 0.5);
+			total += weights_[i];
+		}
+		weights_[radius] += (uint16_t)(256 - total);
+	}
+
+	int GetBlurRadius() const { return radius_; }
+
+	// The LUT is only rebuilt when the value actually changes.
+	void SetGamma(double gamma) {
+		if (gamma == gamma_) return;
+		gamma_ = gamma;
+		fullRefresh_ = true;
+		for (int i = 0; i < 256; i++) {
+			lut_[i] = (uint8_t)(int)(pow((double)i / 255.0, gamma) * 255.0);
+		}
+	}
+
+	double GetGamma() const { return gamma_; }
+
+	// which channel of a multi-channel source is used as intensity, ignored for gray input
+	void SetChannel(int channel) { channel_ = channel; }
+
+	// 0..4, the output is 1/2^levels of the map in both directions
+	void SetReduceLevels(int levels) {
+		levels = std::min(std::max(levels, 0), 4);
+		if (levels == reduceLevels_) return;
+		reduceLevels_ = levels;
+		fullRefresh_ = true;
+	}
+
+	// Learns 1/2^shift of the difference every interval frames; shift 0 turns
+	// subtraction off and the background is relearned once it is back on.
+	void SetBackgroundRate(int shift, int interval) {
+		shift = std::min(std::max(shift, 0), 7);
+		if (shift == 0 && bgShift_ != 0)
+			bgReset_ = true;
+		if ((shift == 0) != (bgShift_ == 0))
+			fullRefresh_ = true;
+		bgShift_ = shift;
+		bgInterval_ = std::max(interval, 1);
+	}
+
+	// the next frame replaces the background as a whole
+	void ResetBackground() { bgReset_ = true; }
+
+	// Mean absolute change per pixel, in gray levels, above which a tile is
+	// processed again; 0 processes the whole frame every time. The output is
+	// then approximate: a tile changing by less keeps its old result and old
+	// background until its row comes up for the periodic refresh.
+	void SetChangeThreshold(float threshold) {
+		// any positive threshold stays tiled, a change of 1 over the tile is the finest
+		const int sad = (threshold > 0) ? std::max((int)(threshold * TILE * TILE), 1) : 0;
+		if (sad == changeThreshold_) return;
+		changeThreshold_ = sad;
+		fullRefresh_ = true;
+	}
+
+	// tiles recomputed by the last Process(), row major; all of them without a change threshold
+	const std::vector<uint8_t>& ChangedTiles() const { return changed_; }
+	// brightest output pixel per tile, kept up to date in tiled mode only
+	const std::vector<uint8_t>& TileMax() const { return tileMax_; }
+	bool IsTiled() const { return changeThreshold_ > 0; }
+	int TileCols() const { return tileCols_; }
+	int TileRows() const { return tileRows_; }
+
+	// output pixels whose background is kept as it is, e.g. under detected
+	// fingers; cheap to call every frame, the mask is only repainted on a change
+	void SetBackgroundFreeze(const std::vector<cv::Rect>& rects) {
+		if (rects == freezeRects_) return;
+		freezeRects_ = rects;
+		freezeDirty_ = true;
+	}
+
+	/*
+	 src        : camera frame, 8-bit gray or interleaved colour
+	 mapXY      : CV_16SC2 nearest-neighbour map from cv::convertMaps, defines the output size
+	              (divided by 2^levels, see SetReduceLevels); may be a ROI of a larger map
+	 dst        : CV_8UC1 result
+	 background : CV_16SC1 model owned by the caller, (re)initialized here; NULL skips subtraction
+	 learnBackground : false subtracts background as it is, e.g. a model learned at
+	                   another resolution; it must then match the output size and is never changed
+	*/
+	void Process(const cv::Mat& src, const cv::Mat& mapXY, cv::Mat& dst, cv::Mat* background = NULL, bool learnBackground = true) {
+		const int cols = mapXY.cols >> reduceLevels_;
+		const int rows = mapXY.rows >> reduceLevels_;
+		dst.create(rows, cols, CV_8UC1);
+		if (cols == 0 || rows == 0) return;
+
+		UpdateOffsets(src, mapXY);
+		Allocate(cols);
+
+		const bool subtract = background != NULL && bgShift_ > 0
+			&& (learnBackground || (background->rows == rows && background->cols == cols && background->type() == CV_16SC1));
+		bool init = false, learn = false;
+		if (subtract && learnBackground) {
+			if (background->rows != rows || background->cols != cols || background->type() != CV_16SC1) {
+				background->create(rows, cols, CV_16SC1);
+				bgReset_ = true;
+			}
+			init = bgReset_;
+			learn = (++bgFrame_ % bgInterval_) == 0;
+			bgReset_ = false;
+			UpdateFreeze(rows, cols);
+		}
+
+		if (init)
+			fullRefresh_ = true;
+
+		// tiled: gather everything first to see what changed, the result is built in last_
+		const bool tiled = changeThreshold_ > 0;
+		const uint8_t* base = src.data;
+		tileCols_ = (cols + TILE - 1) / TILE;
+		tileRows_ = (rows + TILE - 1) / TILE;
+		if (tiled)
+			FindChangedTiles(base, rows, cols);
+		else
+			changed_.assign(tileCols_ * tileRows_, 1);
+		cv::Mat& out = tiled ? last_ : dst;
+
+		int next = 0;
+		for (int y = 0; y < rows; y++) {
+			// keep the ring filled up to the bottom of this row's window
+			const int last = std::min(y + radius_, rows - 1);
+			for (; next <= last; next++) {
+				if (tiled)
+					memcpy(&row_[RADIUS], &gathered_[next * cols], cols);
+				else
+					GatherOutputRow(base, next, cols, &row_[RADIUS]);
+				if (subtract)
+					BackgroundRow(background->ptr<int16_t>(next), learn ? &freeze_[next * cols] : NULL, cols, init, learn);
+				FillApron(cols);
+
+				// every span an output row within the blur radius will read
+				const int ty0 = std::max(next - radius_, 0) / TILE;
+				const int ty1 = std::min(next + radius_, rows - 1) / TILE;
+				for (const auto& span : Spans(ty0, ty1, cols))
+					HBlurRow(span.first, span.second, &ring_[(next % TAPS) * cols]);
+			}
+
+			const uint16_t* taps[TAPS];
+			for (int i = 0; i < taps_; i++) {
+				const int r = std::min(std::max(y + i - radius_, 0), rows - 1);
+				taps[i] = &ring_[(r % TAPS) * cols];
+			}
+			for (const auto& span : Spans(y / TILE, y / TILE, cols))
+				VBlurRow(taps, span.first, span.second, out.ptr<uint8_t>(y));
+		}
+
+		if (tiled) {
+			FinishTiles(rows, cols);
+			for (int y = 0; y < rows; y++)
+				memcpy(dst.ptr<uint8_t>(y), last_.ptr<uint8_t>(y), cols);
+		}
+	}
+
+private:
+	void UpdateOffsets(const cv::Mat& src, const cv::Mat& mapXY) {
+		// a gray source is read as-is, colour is never converted, only one channel is picked
+		const int ch = (src.channels() > 1) ? std::min(channel_, src.channels() - 1) : 0;
+
+		// the table is built for the whole map, a ROI only moves its origin
+		cv::Size whole;
+		cv::Point origin;
+		mapXY.locateROI(whole, origin);
+		offsetsOrigin_ = origin.y * whole.width + origin.x;
+		if (mapXY.datastart == map_.datastart && whole == mapWhole_
+			&& src.cols == srcCols_ && src.rows == srcRows_
+			&& (int)src.step == srcStep_ && src.channels() == srcChannels_ && ch == srcChannel_) {
+			return;
+		}
+
+		// holding the map keeps its memory, and so the cache key, from being reused
+		map_ = mapXY;
+		mapWhole_ = whole;
+		offsetsStride_ = whole.width;
+		srcCols_ = src.cols;
+		srcRows_ = src.rows;
+		srcStep_ = (int)src.step;
+		srcChannels_ = src.channels();
+		srcChannel_ = ch;
+
+		fullRefresh_ = true;
+		const cv::Mat all(whole, mapXY.type(), (void*)mapXY.datastart, mapXY.step);
+		offsets_.resize(all.total());
+		int i = 0;
+		for (int v = 0; v < all.rows; v++) {
+			const short* xy = all.ptr<short>(v);
+			for (int u = 0; u < all.cols; u++, i++) {
+				const int x = xy[u * 2];
+				const int y = xy[u * 2 + 1];
+				offsets_[i] = (x >= 0 && y >= 0 && x < srcCols_ && y < srcRows_)
+					? y * srcStep_ + x * srcChannels_ + ch
+					: -1;
+			}
+		}
+	}
+
+	void Allocate(int cols) {
+		if ((int)ring_.size() == cols * TAPS) return;
+		ring_.assign(cols * TAPS, 0);
+		// left/right apron for the horizontal taps, plus slack for 8-wide loads
+		row_.assign(cols + RADIUS * 2 + 8, 0);
+	}
+
+	void UpdateFreeze(int rows, int cols) {
+		if (!freezeDirty_ && (int)freeze_.size() == rows * cols) return;
+		freezeDirty_ = false;
+		freeze_.assign(rows * cols, 0);
+		const cv::Rect bounds(0, 0, cols, rows);
+		for (const auto& rect : freezeRects_) {
+			const cv::Rect r = rect & bounds;
+			for (int y = r.y; y < r.y + r.height; y++)
+				memset(&freeze_[y * cols + r.x], 0xFF, r.width);
+		}
+	}
+
+	void GatherRow(const uint8_t* base, const int* offsets, int cols, uint8_t* row) {
+		for (int x = 0; x < cols; x++) {
+			const int o = offsets[x];
+			row[x] = (o < 0) ? 0 : base[o];
+		}
+	}
+
+	// output row y; reduced, each pixel is the rounded mean of its square of map pixels
+	void GatherOutputRow(const uint8_t* base, int y, int cols, uint8_t* row) {
+		const int n = 1 << reduceLevels_;
+		const int* offsets = &offsets_[offsetsOrigin_ + y * n * offsetsStride_];
+		if (n == 1) {
+			GatherRow(base, offsets, cols, row);
+			return;
+		}
+
+		// at most 16 x 16 x 255, fits the 16-bit sums
+		sum_.assign(cols, 0);
+		for (int k = 0; k < n; k++, offsets += offsetsStride_) {
+			for (int x = 0; x < cols; x++) {
+				const int* o = &offsets[x * n];
+				int acc = 0;
+				for (int j = 0; j < n; j++)
+					acc += (o[j] < 0) ? 0 : base[o[j]];
+				sum_[x] = (uint16_t)(sum_[x] + acc);
+			}
+		}
+		const int shift = reduceLevels_ * 2;
+		for (int x = 0; x < cols; x++)
+			row[x] = (uint8_t)((sum_[x] + (1 << (shift - 1))) >> shift);
+	}
+
+	// gathers the whole frame into gathered_ and marks the tiles to recompute in changed_
+	void FindChangedTiles(const uint8_t* base, int rows, int cols) {
+		const int tileCols = tileCols_;
+		const int tileRows = tileRows_;
+		if (last_.rows != rows || last_.cols != cols) {
+			last_.create(rows, cols, CV_8UC1);
+			gathered_.assign(rows * cols, 0);
+			reference_.assign(rows * cols, 0);
+			tileMax_.assign(tileCols * tileRows, 0);
+			fullRefresh_ = true;
+		}
+
+		sad_.assign(tileCols * tileRows, 0);
+		for (int y = 0; y < rows; y++) {
+			uint8_t* row = &gathered_[y * cols];
+			GatherOutputRow(base, y, cols, row);
+			SadRow(row, &reference_[y * cols], cols, &sad_[(y / TILE) * tileCols]);
+		}
+
+		refreshRow_ = (refreshRow_ + 1) % tileRows;
+		std::vector<uint8_t>& hit = changedRaw_;
+		hit.assign(tileCols * tileRows, 0);
+		for (int ty = 0; ty < tileRows; ty++) {
+			for (int tx = 0; tx < tileCols; tx++) {
+				const int i = ty * tileCols + tx;
+				hit[i] = fullRefresh_ || ty == refreshRow_ || sad_[i] > (uint32_t)changeThreshold_;
+			}
+		}
+		fullRefresh_ = false;
+
+		// the blur carries a change into the neighbouring tiles
+		changed_.assign(tileCols * tileRows, 0);
+		for (int ty = 0; ty < tileRows; ty++) {
+			for (int tx = 0; tx < tileCols; tx++) {
+				if (!hit[ty * tileCols + tx]) continue;
+				for (int y = std::max(ty - 1, 0); y <= std::min(ty + 1, tileRows - 1); y++) {
+					for (int x = std::max(tx - 1, 0); x <= std::min(tx + 1, tileCols - 1); x++)
+						changed_[y * tileCols + x] = 1;
+				}
+			}
+		}
+	}
+
+	// adds |cur - ref| of one row to the sums of the tiles it crosses
+	static void SadRow(const uint8_t* cur, const uint8_t* ref, int cols, uint32_t* sad) {
+		int x = 0;
+#ifdef PHOTOMETRIC_SSE2
+		for (; x + TILE <= cols; x += TILE) {
+			const __m128i d = _mm_sad_epu8(_mm_loadu_si128((const __m128i*)(cur + x)), _mm_loadu_si128((const __m128i*)(ref + x)));
+			sad[x / TILE] += (uint32_t)(_mm_cvtsi128_si32(d) + _mm_cvtsi128_si32(_mm_srli_si128(d, 8)));
+		}
+#endif
+		for (; x < cols; x++)
+			sad[x / TILE] += (uint32_t)std::abs(cur[x] - ref[x]);
+	}
+
+	// recomputed tiles become the new reference and get their maximum updated
+	void FinishTiles(int rows, int cols) {
+		for (int ty = 0; ty < tileRows_; ty++) {
+			const int y0 = ty * TILE, y1 = std::min(y0 + TILE, rows);
+			for (int tx = 0; tx < tileCols_; tx++) {
+				if (!changed_[ty * tileCols_ + tx]) continue;
+				const int x0 = tx * TILE, x1 = std::min(x0 + TILE, cols);
+				uint8_t peak = 0;
+				for (int y = y0; y < y1; y++) {
+					memcpy(&reference_[y * cols + x0], &gathered_[y * cols + x0], x1 - x0);
+					const uint8_t* out = last_.ptr<uint8_t>(y);
+					for (int x = x0; x < x1; x++)
+						peak = std::max(peak, out[x]);
+				}
+				tileMax_[ty * tileCols_ + tx] = peak;
+			}
+		}
+	}
+
+	// column spans [x0, x1) covered by changed tiles in tile rows ty0..ty1
+	const std::vector<std::pair<int, int>>& Spans(int ty0, int ty1, int cols) {
+		spans_.clear();
+		const int tileCols = tileCols_;
+		int start = -1;
+		for (int tx = 0; tx <= tileCols; tx++) {
+			bool on = false;
+			for (int ty = ty0; tx < tileCols && ty <= ty1 && !on; ty++)
+				on = changed_[ty * tileCols + tx] != 0;
+			if (on && start < 0) {
+				start = tx;
+			}
+			else if (!on && start >= 0) {
+				spans_.push_back(std::make_pair(start * TILE, std::min(tx * TILE, cols)));
+				start = -1;
+			}
+		}
+		return spans_;
+	}
+
+	void FillApron(int cols) {
+		uint8_t* row = &row_[RADIUS];
+		for (int i = 1; i <= RADIUS; i++) {
+			row[-i] = row[0];
+			row[cols - 1 + i] = row[cols - 1];
+		}
+	}
+
+	// learns the gathered row into bg (unless frozen), then subtracts it
+	void BackgroundRow(int16_t* bg, const uint8_t* freeze, int cols, bool init, bool learn) {
+		uint8_t* row = &row_[RADIUS];
+		int x = 0;
+#ifdef PHOTOMETRIC_SSE2
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i shift = _mm_cvtsi32_si128(bgShift_);
+		for (; x + 8 <= cols; x += 8) {
+			const __m128i p = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(row + x)), zero);
+			const __m128i p7 = _mm_slli_epi16(p, 7);
+			__m128i b = _mm_loadu_si128((const __m128i*)(bg + x));
+			if (init) {
+				b = p7;
+				_mm_storeu_si128((__m128i*)(bg + x), b);
+			}
+			else if (learn) {
+				const __m128i f = _mm_loadl_epi64((const __m128i*)(freeze + x));
+				const __m128i frozen = _mm_unpacklo_epi8(f, f);
+				const __m128i learned = _mm_add_epi16(b, _mm_sra_epi16(_mm_sub_epi16(p7, b), shift));
+				b = _mm_or_si128(_mm_and_si128(frozen, b), _mm_andnot_si128(frozen, learned));
+				_mm_storeu_si128((__m128i*)(bg + x), b);
+			}
+			const __m128i fg = _mm_subs_epu16(p, _mm_srai_epi16(b, 7));
+			_mm_storel_epi64((__m128i*)(row + x), _mm_packus_epi16(fg, zero));
+		}
+#endif
+		for (; x < cols; x++) {
+			const int p7 = row[x] << 7;
+			if (init)
+				bg[x] = (int16_t)p7;
+			else if (learn && !freeze[x])
+				bg[x] = (int16_t)(bg[x] + ((p7 - bg[x]) >> bgShift_));
+			const int fg = row[x] - (bg[x] >> 7);
+			row[x] = (uint8_t)std::max(fg, 0);
+		}
+	}
+
+	void HBlurRow(int x0, int x1, uint16_t* dst) {
+		// the apron is sized for RADIUS, a smaller kernel starts further in
+		const uint8_t* row = &row_[RADIUS - radius_];
+		int x = x0;
+#ifdef PHOTOMETRIC_SSE2
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i half = _mm_set1_epi16(128);
+		for (; x + 8 <= x1; x += 8) {
+			__m128i acc = half;
+			for (int i = 0; i < taps_; i++) {
+				__m128i p = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(row + x + i)), zero);
+				acc = _mm_add_epi16(acc, _mm_mullo_epi16(p, _mm_set1_epi16(weights_[i])));
+			}
+			_mm_storeu_si128((__m128i*)(dst + x), _mm_srli_epi16(acc, 8));
+		}
+#endif
+		for (; x < x1; x++) {
+			unsigned acc = 128;
+			for (int i = 0; i < taps_; i++) {
+				acc += weights_[i] * row[x + i];
+			}
+			dst[x] = (uint16_t)(acc >> 8);
+		}
+	}
+
+	void VBlurRow(const uint16_t* const* taps, int x0, int x1, uint8_t* dst) {
+		int x = x0;
+#ifdef PHOTOMETRIC_SSE2
+		const __m128i half = _mm_set1_epi16(128);
+		const __m128i zero = _mm_setzero_si128();
+		alignas(16) uint8_t blurred[16];
+		for (; x + 8 <= x1; x += 8) {
+			__m128i acc = half;
+			for (int i = 0; i < taps_; i++) {
+				__m128i p = _mm_loadu_si128((const __m128i*)(taps[i] + x));
+				acc = _mm_add_epi16(acc, _mm_mullo_epi16(p, _mm_set1_epi16(weights_[i])));
+			}
+			_mm_store_si128((__m128i*)blurred, _mm_packus_epi16(_mm_srli_epi16(acc, 8), zero));
+			for (int k = 0; k < 8; k++) {
+				dst[x + k] = lut_[blurred[k]];
+			}
+		}
+#endif
+		for (; x < x1; x++) {
+			unsigned acc = 128;
+			for (int i = 0; i < taps_; i++) {
+				acc += weights_[i] * taps[i][x];
+			}
+			dst[x] = lut_[acc >> 8];
+		}
+	}
+
+	double gamma_;
+	int channel_;
+	uint8_t lut_[256];
+	int radius_;
+	int taps_;
+	uint16_t weights_[TAPS];
+
+	int bgShift_;
+	int bgInterval_;
+	unsigned bgFrame_;
+	bool bgReset_;
+	std::vector<cv::Rect> freezeRects_;
+	bool freezeDirty_;
+	std::vector<uint8_t> freeze_;
+
+	int changeThreshold_;	// SAD per tile
+	int tileCols_;
+	int tileRows_;
+	int refreshRow_;
+	bool fullRefresh_;
+	std::vector<uint8_t> gathered_;
+	std::vector<uint8_t> reference_;
+	std::vector<uint32_t> sad_;
+	std::vector<uint8_t> changedRaw_;
+	std::vector<uint8_t> changed_;
+	std::vector<uint8_t> tileMax_;
+	std::vector<std::pair<int, int>> spans_;
+	cv::Mat last_;
+
+	cv::Mat map_;	// the last map, a ROI of mapWhole_
+	cv::Size mapWhole_;
+	int srcCols_;
+	int srcRows_;
+	int srcStep_;
+	int srcChannels_;
+	int srcChannel_;
+	int reduceLevels_;
+	std::vector<int> offsets_;	// for the whole map, row major
+	int offsetsOrigin_;	// index of the ROI's top-left pixel
+	int offsetsStride_;	// whole map columns
+	std::vector<uint16_t> sum_;
+
+	std::vector<uint16_t> ring_;
+	std::vector<uint8_t> row_;
+};
@@ -0,0 +1,307 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/*
+ Raw frame recording, laid out so that writing costs one sequential copy
+ per frame and reading costs nothing:
+
+   [header, 4 KiB][index, capacity entries][frame 0][frame 1]...
+
+ Every frame occupies the same 4 KiB aligned stride, so frame i sits at a
+ fixed offset and the whole file is sized when the recording starts. The
+ header keeps what is needed to reproduce a session: size and pixel
+ format, the calibration and the app's parameters as JSON text.
+*/
+struct RawRecordingHeader {
+	char magic[8];	// "OFTRAW1"
+	uint32_t version;
+	uint32_t width;
+	uint32_t height;
+	uint32_t format;	// MyCamBase::PixelFormat
+	uint32_t channels;	// 8-bit channels per pixel
+	uint32_t stride;	// bytes between two frames in the file
+	uint32_t capacity;	// frames the file was sized for
+	uint32_t count;	// frames actually written
+	uint64_t indexOffset;
+	uint64_t dataOffset;
+	double pm[9];	// calibration homography, row major
+	float rect[8];	// calibration corners x0, y0 .. x3, y3
+	char params[2048];	// parameters as JSON text
+};
+
+struct RawFrameIndex {
+	uint64_t timestamp;	// camera timestamp in ofGetElapsedTimeMicros() of the recording session
+	uint64_t sequence;
+	uint64_t offset;	// of the frame's first byte, from the start of the file
+};
+
+namespace rawrecording {
+	static const char MAGIC[8] = "OFTRAW1";
+	static const uint32_t VERSION = 1;
+	static const uint64_t ALIGN = 4096;
+
+	inline uint64_t Align(uint64_t size) { return (size + ALIGN - 1) & ~(ALIGN - 1); }
+
+	// channels of every MyCamBase::PixelFormat, in enum order
+	static const uint32_t FORMAT_CHANNELS[] = { 1, 3, 4 };
+	static const uint32_t FORMAT_COUNT = sizeof(FORMAT_CHANNELS) / sizeof(FORMAT_CHANNELS[0]);
+}
+
+/*
+ Writes a recording on its own thread. Push() only queues a reference to
+ the camera's frame, the pixels are written straight from the pool slot,
+ which goes back to the camera once the write is done. Frames are written
+ through the stream at their fixed offsets; only RawRecording maps the file.
+*/
+class RawRecorder
+{
+public:
+	enum { QUEUE_SIZE = 4 };
+
+	RawRecorder() : running_(false), written_(0), dropped_(0) {}
+	~RawRecorder() { Close(); }
+
+	// info provides size, format, calibration and params; the rest is filled in here
+	bool Open(const std::string& path, const RawRecordingHeader& info, uint32_t capacity) {
+		Close();
+
+		header_ = info;
+		memcpy(header_.magic, rawrecording::MAGIC, sizeof(header_.magic));
+		header_.version = rawrecording::VERSION;
+		header_.stride = (uint32_t)rawrecording::Align((uint64_t)info.width * info.height * info.channels);
+		header_.capacity = capacity;
+		header_.count = 0;
+		header_.indexOffset = rawrecording::Align(sizeof(RawRecordingHeader));
+		header_.dataOffset = header_.indexOffset + rawrecording::Align((uint64_t)capacity * sizeof(RawFrameIndex));
+
+		file_.open(path, std::ios::binary | std::ios::out | std::ios::trunc);
+		if (!file_.is_open())
+			return false;
+
+		// size the file once, frames then only overwrite
+		const uint64_t size = header_.dataOffset + (uint64_t)capacity * header_.stride;
+		file_.seekp(size - 1);
+		file_.put(0);
+		if (!file_.good()) {
+			file_.close();
+			return false;
+		}
+
+		index_.clear();
+		index_.reserve(capacity);
+		written_ = 0;
+		dropped_ = 0;
+		running_ = true;
+		thread_ = std::thread(&RawRecorder::Run, this);
+		return true;
+	}
+
+	// single producer; never blocks, a full queue drops the frame from the recording
+	bool Push(const FrameRef& frame) {
+		if (!running_)
+			return false;
+		if (!queue_.Push(frame)) {
+			dropped_++;
+			return false;
+		}
+		return true;
+	}
+
+	// writes what is still queued, then the index and the header
+	void Close() {
+		if (!running_) return;
+		running_ = false;
+		queue_.Wake();
+		thread_.join();
+
+		header_.count = (uint32_t)index_.size();
+		if (!index_.empty()) {
+			file_.seekp(header_.indexOffset);
+			file_.write((const char*)index_.data(), index_.size() * sizeof(RawFrameIndex));
+		}
+		file_.seekp(0);
+		file_.write((const char*)&header_, sizeof(header_));
+		file_.close();
+	}
+
+	bool IsOpen() const { return running_; }
+	uint64_t GetWritten() const { return written_; }
+	uint64_t GetDropped() const { return dropped_; }
+
+private:
+	void Run() {
+		FrameRef frame;
+		while (running_ || queue_.Size() != 0) {
+			if (!queue_.WaitPop(frame, std::chrono::milliseconds(100)))
+				continue;
+			Write(frame->image, frame->timestamp, frame->sequence);
+			frame.Release();
+		}
+	}
+
+	void Write(const cv::Mat& image, uint64_t timestamp, uint64_t sequence) {
+		if (index_.size() >= header_.capacity) {
+			dropped_++;
+			return;
+		}
+
+		RawFrameIndex entry;
+		entry.timestamp = timestamp;
+		entry.sequence = sequence;
+		entry.offset = header_.dataOffset + (uint64_t)index_.size() * header_.stride;
+
+		const size_t rowBytes = (size_t)header_.width * header_.channels;
+		file_.seekp(entry.offset);
+		if (image.isContinuous()) {
+			file_.write((const char*)image.data, rowBytes * header_.height);
+		}
+		else {
+			for (uint32_t y = 0; y < header_.height; y++)
+				file_.write((const char*)image.ptr(y), rowBytes);
+		}
+
+		index_.push_back(entry);
+		written_++;
+	}
+
+	RawRecordingHeader header_;
+	std::ofstream file_;
+	std::vector<RawFrameIndex> index_;
+
+	SpscRing<FrameRef, QUEUE_SIZE> queue_;
+	std::thread thread_;
+	std::atomic<bool> running_;
+	std::atomic<uint64_t> written_;
+	std::atomic<uint64_t> dropped_;
+};
+
+/*
+ Read-only view of a recording through a memory mapping. Frame() returns
+ an image header pointing into the mapping, nothing is copied or decoded;
+ the pixels must not be written to.
+*/
+class RawRecording
+{
+public:
+	RawRecording() : data_(NULL), size_(0) {}
+	~RawRecording() { Close(); }
+
+	bool Open(const std::string& path) {
+		Close();
+		if (!Map(path))
+			return false;
+
+		if (size_ < sizeof(RawRecordingHeader)
+			|| memcmp(Header().magic, rawrecording::MAGIC, sizeof(rawrecording::MAGIC)) != 0
+			|| Header().version != rawrecording::VERSION
+			|| Header().indexOffset + (uint64_t)Header().count * sizeof(RawFrameIndex) > size_
+			|| Header().dataOffset + (uint64_t)Header().count * Header().stride > size_
+			|| Header().format >= rawrecording::FORMAT_COUNT
+			|| Header().channels != rawrecording::FORMAT_CHANNELS[Header().format]
+			|| (uint64_t)Header().width * Header().height * Header().channels > Header().stride) {
+			Close();
+			return false;
+		}
+
+		// Frame() trusts the index, a corrupt entry must not point past the mapping
+		const uint64_t frameSize = (uint64_t)Header().width * Header().height * Header().channels;
+		for (uint32_t i = 0; i < Count(); i++) {
+			if (Index(i).offset < Header().dataOffset || Index(i).offset > size_ - frameSize) {
+				Close();
+				return false;
+			}
+		}
+		return true;
+	}
+
+	void Close() {
+		if (data_ == NULL) return;
+#ifdef _WIN32
+		UnmapViewOfFile(data_);
+		CloseHandle(mapping_);
+		CloseHandle(file_);
+#else
+		munmap(data_, size_);
+#endif
+		data_ = NULL;
+		size_ = 0;
+	}
+
+	bool IsOpen() const { return data_ != NULL; }
+
+	const RawRecordingHeader& Header() const { return *(const RawRecordingHeader*)data_; }
+	uint32_t Count() const { return Header().count; }
+
+	const RawFrameIndex& Index(uint32_t i) const {
+		return ((const RawFrameIndex*)(data_ + Header().indexOffset))[i];
+	}
+
+	// valid until Close()
+	cv::Mat Frame(uint32_t i) const {
+		const RawRecordingHeader& h = Header();
+		return cv::Mat(h.height, h.width, CV_MAKETYPE(CV_8U, h.channels), data_ + Index(i).offset);
+	}
+
+private:
+	bool Map(const std::string& path) {
+#ifdef _WIN32
+		file_ = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+		if (file_ == INVALID_HANDLE_VALUE)
+			return false;
+		LARGE_INTEGER size;
+		mapping_ = GetFileSizeEx(file_, &size) ? CreateFileMappingA(file_, NULL, PAGE_READONLY, 0, 0, NULL) : NULL;
+		if (mapping_ == NULL) {
+			CloseHandle(file_);
+			return false;
+		}
+		data_ = (uint8_t*)MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0);
+		if (data_ == NULL) {
+			CloseHandle(mapping_);
+			CloseHandle(file_);
+			return false;
+		}
+		size_ = (uint64_t)size.QuadPart;
+#else
+		const int fd = open(path.c_str(), O_RDONLY);
+		if (fd < 0)
+			return false;
+		struct stat st;
+		if (fstat(fd, &st) != 0 || st.st_size == 0) {
+			close(fd);
+			return false;
+		}
+		void* data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+		close(fd);
+		if (data == MAP_FAILED)
+			return false;
+		madvise(data, (size_t)st.st_size, MADV_SEQUENTIAL);
+		data_ = (uint8_t*)data;
+		size_ = (uint64_t)st.st_size;
+#endif
+		return true;
+	}
+
+	uint8_t* data_;
+	uint64_t size_;
+#ifdef _WIN32
+	HANDLE file_;
+	HANDLE mapping_;
+#endif
+};
@@ -0,0 +1,169 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+/*
+ Frame-to-frame point association, a drop-in for ofxCv::RectTracker with
+ the same label semantics (persistence, maximum distance, dead labels).
+
+ Known points are bucketed into a uniform grid whose cells are as wide as
+ the maximum distance, so every possible match of a new point lies in the
+ 3x3 cells around it. Candidate pairs are then resolved closest first,
+ each point and each known point taking part in at most one match. With
+ a bounded number of contacts per cell the cost grows close to linearly
+ with the number of contacts.
+*/
+class SpatialTracker
+{
+public:
+	SpatialTracker()
+		: persistence_(15),
+		maxDistance_(64),
+		nextLabel_(0) {}
+
+	// frames a point may go unseen before its label is given up
+	void SetPersistence(unsigned int persistence) { persistence_ = persistence; }
+	void SetMaximumDistance(float distance) { maxDistance_ = std::max(distance, 1.0f); }
+
+	// returns one label per point, in the order of points
+	const std::vector<unsigned int>& Track(const std::vector<cv::Point2f>& points) {
+		labels_.assign(points.size(), 0);
+		deadLabels_.clear();
+
+		BuildGrid();
+		CollectCandidates(points);
+
+		// closest pairs first, ties broken by index so results are deterministic
+		std::sort(candidates_.begin(), candidates_.end(), [](const Candidate& a, const Candidate& b) {
+			if (a.distance != b.distance) return a.distance < b.distance;
+			if (a.point != b.point) return a.point < b.point;
+			return a.known < b.known;
+			});
+
+		matched_.assign(points.size(), false);
+		for (auto& known : known_)
+			known.matched = false;
+
+		for (const auto& c : candidates_) {
+			if (matched_[c.point] || known_[c.known].matched)
+				continue;
+			matched_[c.point] = true;
+			known_[c.known].matched = true;
+			known_[c.known].pos = points[c.point];
+			known_[c.known].lastSeen = 0;
+			labels_[c.point] = known_[c.known].label;
+		}
+
+		// unmatched known points age and eventually die, order is not preserved
+		for (size_t i = 0; i < known_.size();) {
+			Known& known = known_[i];
+			if (!known.matched && ++known.lastSeen > persistence_) {
+				deadLabels_.push_back(known.label);
+				known = known_.back();
+				known_.pop_back();
+				continue;
+			}
+			i++;
+		}
+
+		for (size_t i = 0; i < points.size(); i++) {
+			if (matched_[i]) continue;
+			Known known;
+			known.label = nextLabel_++;
+			known.pos = points[i];
+			known.lastSeen = 0;
+			known.matched = true;
+			known_.push_back(known);
+			labels_[i] = known.label;
+		}
+
+		return labels_;
+	}
+
+	const std::vector<unsigned int>& Labels() const { return labels_; }
+
+	// labels that exceeded the persistence during the last Track()
+	const std::vector<unsigned int>& DeadLabels() const { return deadLabels_; }
+
+private:
+	struct Known {
+		unsigned int label;
+		cv::Point2f pos;
+		unsigned int lastSeen;
+		bool matched;
+	};
+
+	struct Candidate {
+		float distance;	// squared
+		int point;
+		int known;
+	};
+
+	struct Cell {
+		uint64_t key;
+		int known;
+		bool operator<(const Cell& other) const { return key < other.key; }
+	};
+
+	uint64_t CellKey(int cx, int cy) const {
+		return ((uint64_t)(uint32_t)cx << 32) | (uint32_t)cy;
+	}
+
+	int CellOf(float v) const {
+		return (int)std::floor(v / maxDistance_);
+	}
+
+	// sorted (cell, index) pairs, a cell's entries are found with equal_range
+	void BuildGrid() {
+		cells_.resize(known_.size());
+		for (size_t i = 0; i < known_.size(); i++) {
+			cells_[i].key = CellKey(CellOf(known_[i].pos.x), CellOf(known_[i].pos.y));
+			cells_[i].known = (int)i;
+		}
+		std::sort(cells_.begin(), cells_.end());
+	}
+
+	void CollectCandidates(const std::vector<cv::Point2f>& points) {
+		candidates_.clear();
+		const float maxDistance2 = maxDistance_ * maxDistance_;
+		for (size_t i = 0; i < points.size(); i++) {
+			const cv::Point2f& p = points[i];
+			const int cx = CellOf(p.x);
+			const int cy = CellOf(p.y);
+			for (int dy = -1; dy <= 1; dy++) {
+				for (int dx = -1; dx <= 1; dx++) {
+					Cell probe;
+					probe.key = CellKey(cx + dx, cy + dy);
+					auto range = std::equal_range(cells_.begin(), cells_.end(), probe);
+					for (auto it = range.first; it != range.second; ++it) {
+						const cv::Point2f& q = known_[it->known].pos;
+						const float ex = p.x - q.x;
+						const float ey = p.y - q.y;
+						const float d2 = ex * ex + ey * ey;
+						if (d2 > maxDistance2) continue;
+
+						Candidate c;
+						c.distance = d2;
+						c.point = (int)i;
+						c.known = it->known;
+						candidates_.push_back(c);
+					}
+				}
+			}
+		}
+	}
+
+	unsigned int persistence_;
+	float maxDistance_;
+	unsigned int nextLabel_;
+
+	std::vector<Known> known_;
+	std::vector<Cell> cells_;
+	std::vector<Candidate> candidates_;
+	std::vector<bool> matched_;
+	std::vector<unsigned int> labels_;
+	std::vector<unsigned int> deadLabels_;
+};
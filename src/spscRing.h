@@ -0,0 +1,163 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <utility>
+
+/*
+ Bounded single-producer / single-consumer ring.
+
+ Push and Pop are wait-free and never take a lock. WaitPop lets an idle
+ consumer sleep instead of spinning: it only touches the mutex once the
+ ring has been seen empty, and the producer only notifies when a consumer
+ has announced that it is about to sleep.
+ N must be a power of two.
+*/
+template <class T, size_t N>
+class SpscRing
+{
+	static_assert((N & (N - 1)) == 0, "SpscRing size must be a power of two");
+
+public:
+	SpscRing() : head_(0), tail_(0), waiting_(false) {}
+
+	// producer side
+	bool Push(const T& item) {
+		const size_t tail = tail_.load(std::memory_order_relaxed);
+		if (tail - head_.load(std::memory_order_acquire) == N)
+			return false;
+
+		items_[tail & (N - 1)] = item;
+		tail_.store(tail + 1, std::memory_order_seq_cst);
+
+		if (waiting_.load(std::memory_order_seq_cst)) {
+			std::lock_guard<std::mutex> guard(mutex_);
+			cond_.notify_one();
+		}
+		return true;
+	}
+
+	// consumer side
+	bool Pop(T& item) {
+		const size_t head = head_.load(std::memory_order_relaxed);
+		if (head == tail_.load(std::memory_order_acquire))
+			return false;
+
+		// moved out, so the ring keeps no reference to handle-like items
+		item = std::move(items_[head & (N - 1)]);
+		head_.store(head + 1, std::memory_order_release);
+		return true;
+	}
+
+	// Consumer side. Swaps instead of moving: the slot keeps item's old value
+	// and with it any storage, e.g. a vector's capacity, that the next Push
+	// copies into. Only for items that don't hold references.
+	bool PopSwap(T& item) {
+		const size_t head = head_.load(std::memory_order_relaxed);
+		if (head == tail_.load(std::memory_order_acquire))
+			return false;
+
+		using std::swap;
+		swap(item, items_[head & (N - 1)]);
+		head_.store(head + 1, std::memory_order_release);
+		return true;
+	}
+
+	// consumer side, sleeps for at most timeout when the ring is empty
+	template <class Rep, class Period>
+	bool WaitPop(T& item, const std::chrono::duration<Rep, Period>& timeout) {
+		if (Pop(item))
+			return true;
+		Sleep(timeout);
+		return Pop(item);
+	}
+
+	template <class Rep, class Period>
+	bool WaitPopSwap(T& item, const std::chrono::duration<Rep, Period>& timeout) {
+		if (PopSwap(item))
+			return true;
+		Sleep(timeout);
+		return PopSwap(item);
+	}
+
+	// wakes a consumer blocked in WaitPop, e.g. on shutdown
+	void Wake() {
+		std::lock_guard<std::mutex> guard(mutex_);
+		cond_.notify_all();
+	}
+
+	size_t Size() const {
+		return tail_.load(std::memory_order_acquire) - head_.load(std::memory_order_acquire);
+	}
+
+private:
+	template <class Rep, class Period>
+	void Sleep(const std::chrono::duration<Rep, Period>& timeout) {
+		std::unique_lock<std::mutex> guard(mutex_);
+		waiting_.store(true, std::memory_order_seq_cst);
+		cond_.wait_for(guard, timeout, [this] {
+			return head_.load(std::memory_order_relaxed) != tail_.load(std::memory_order_seq_cst);
+		});
+		waiting_.store(false, std::memory_order_relaxed);
+	}
+
+	T items_[N];
+	alignas(64) std::atomic<size_t> head_;
+	alignas(64) std::atomic<size_t> tail_;
+
+	std::atomic<bool> waiting_;
+	std::mutex mutex_;
+	std::condition_variable cond_;
+};
+
+/*
+ Lets one consumer sleep on several rings at once. Producers call Notify()
+ after each Push; the consumer reads Value() before it checks its rings
+ and hands it to Wait(), which returns as soon as anything was pushed
+ since. As with SpscRing, the mutex is only touched when the consumer
+ actually sleeps.
+*/
+class RingSignal
+{
+public:
+	RingSignal() : count_(0), waiting_(false) {}
+
+	// producer side, any number of threads
+	void Notify() {
+		count_.fetch_add(1, std::memory_order_seq_cst);
+		if (waiting_.load(std::memory_order_seq_cst)) {
+			std::lock_guard<std::mutex> guard(mutex_);
+			cond_.notify_one();
+		}
+	}
+
+	// consumer side
+	uint64_t Value() const { return count_.load(std::memory_order_seq_cst); }
+
+	// consumer side, false on timeout
+	template <class Rep, class Period>
+	bool Wait(uint64_t value, const std::chrono::duration<Rep, Period>& timeout) {
+		std::unique_lock<std::mutex> guard(mutex_);
+		waiting_.store(true, std::memory_order_seq_cst);
+		const bool signalled = cond_.wait_for(guard, timeout, [this, value] {
+			return count_.load(std::memory_order_seq_cst) != value;
+		});
+		waiting_.store(false, std::memory_order_relaxed);
+		return signalled;
+	}
+
+	void Wake() {
+		std::lock_guard<std::mutex> guard(mutex_);
+		cond_.notify_all();
+	}
+
+private:
+	std::atomic<uint64_t> count_;
+	std::atomic<bool> waiting_;
+	std::mutex mutex_;
+	std::condition_variable cond_;
+};
@@ -0,0 +1,283 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <thread>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/*
+ Touch frames in shared memory, for consumers on the same machine that
+ would rather not go through OSC and the loopback. This header has no
+ dependency on the rest of the tracker and is all a reader needs.
+
+   [header][slot 0][slot 1]...[slot SLOTS-1]
+
+ Frame n goes to slot n % SLOTS. Every slot is guarded by a sequence
+ counter that is odd while the tracker writes and 2n + 2 once frame n is
+ complete; a reader copies the slot and keeps the copy only if the counter
+ was the same, even value before and after. The tracker never waits for
+ readers, and readers never write to the mapping.
+*/
+namespace touchring {
+	static const char MAGIC[8] = "OFTTCH1";
+	static const uint32_t VERSION = 1;
+	static const uint32_t SLOTS = 8;
+	static const uint32_t MAX_TOUCHES = 256;
+	static const char* const DEFAULT_NAME = "ofTracker-touches";
+
+	enum State {
+		DOWN = 1,	// first frame of a touch
+		MOVE = 2,
+		UP = 3	// last frame, the touch is gone in the next one
+	};
+}
+
+struct TouchRingTouch {
+	int32_t id;
+	int32_t state;	// touchring::State
+	float x, y;	// normalized to 0..1, as sent over TUIO
+	float vx, vy;	// per second
+};
+
+struct TouchRingFrame {
+	uint64_t frame;	// counts up from 1, one per tracker frame
+	uint64_t timestamp;	// camera capture time, microseconds; add clockBase for steady_clock
+	uint32_t count;
+	uint32_t reserved;
+	TouchRingTouch touches[touchring::MAX_TOUCHES];
+};
+
+struct TouchRingSlot {
+	alignas(64) std::atomic<uint64_t> sequence;
+	TouchRingFrame frame;
+};
+
+struct TouchRingHeader {
+	char magic[8];	// "OFTTCH1", written last
+	uint32_t version;
+	uint32_t slots;
+	uint32_t maxTouches;
+	uint32_t slotSize;
+	uint64_t clockBase;	// steady_clock microseconds at timestamp 0
+	alignas(64) std::atomic<uint64_t> latest;	// newest complete frame, 0 before the first
+};
+
+namespace touchring {
+	inline size_t MappingSize() { return sizeof(TouchRingHeader) + SLOTS * sizeof(TouchRingSlot); }
+
+	// maps name read-only, or created and writable; returns NULL on failure
+	inline uint8_t* Map(const std::string& name, bool create, void** handle) {
+		const size_t size = MappingSize();
+#ifdef _WIN32
+		const std::string path = "Local\\" + name;
+		HANDLE mapping = create
+			? CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0, (DWORD)size, path.c_str())
+			: OpenFileMappingA(FILE_MAP_READ, FALSE, path.c_str());
+		if (mapping == NULL)
+			return NULL;
+		void* data = MapViewOfFile(mapping, create ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, size);
+		if (data == NULL) {
+			CloseHandle(mapping);
+			return NULL;
+		}
+		*handle = mapping;
+		return (uint8_t*)data;
+#else
+		const std::string path = "/" + name;
+		const int fd = create ? shm_open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644) : shm_open(path.c_str(), O_RDONLY, 0);
+		if (fd < 0)
+			return NULL;
+		struct stat st;
+		if ((create && ftruncate(fd, (off_t)size) != 0) || fstat(fd, &st) != 0 || (size_t)st.st_size < size) {
+			close(fd);
+			return NULL;
+		}
+		void* data = mmap(NULL, size, create ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0);
+		close(fd);
+		*handle = NULL;
+		return (data == MAP_FAILED) ? NULL : (uint8_t*)data;
+#endif
+	}
+
+	inline void Unmap(uint8_t* data, void* handle) {
+#ifdef _WIN32
+		UnmapViewOfFile(data);
+		CloseHandle((HANDLE)handle);
+#else
+		(void)handle;
+		munmap(data, MappingSize());
+#endif
+	}
+}
+
+// tracker side, a single writer
+class TouchRingWriter
+{
+public:
+	TouchRingWriter() : data_(NULL), handle_(NULL), frame_(0) {}
+	~TouchRingWriter() { Close(); }
+
+	bool Open(const std::string& name, uint64_t clockBase) {
+		Close();
+		data_ = touchring::Map(name, true, &handle_);
+		if (data_ == NULL)
+			return false;
+		name_ = name;
+
+		TouchRingHeader* header = Header();
+		header->version = touchring::VERSION;
+		header->slots = touchring::SLOTS;
+		header->maxTouches = touchring::MAX_TOUCHES;
+		header->slotSize = sizeof(TouchRingSlot);
+		header->clockBase = clockBase;
+		header->latest.store(0, std::memory_order_relaxed);
+		for (uint32_t i = 0; i < touchring::SLOTS; i++)
+			Slot(i)->sequence.store(0, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+		memcpy(header->magic, touchring::MAGIC, sizeof(header->magic));
+		frame_ = 0;
+		return true;
+	}
+
+	void Close() {
+		if (data_ == NULL) return;
+		touchring::Unmap(data_, handle_);
+#ifndef _WIN32
+		// readers keep their mapping, new ones wait for the next Open()
+		shm_unlink(("/" + name_).c_str());
+#endif
+		data_ = NULL;
+	}
+
+	bool IsOpen() const { return data_ != NULL; }
+
+	// touches beyond MAX_TOUCHES are left out
+	void Publish(uint64_t timestamp, const TouchRingTouch* touches, size_t count) {
+		if (data_ == NULL) return;
+
+		const uint64_t n = ++frame_;
+		TouchRingSlot* slot = Slot((uint32_t)(n % touchring::SLOTS));
+		slot->sequence.store(2 * n + 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+
+		slot->frame.frame = n;
+		slot->frame.timestamp = timestamp;
+		slot->frame.count = (uint32_t)std::min(count, (size_t)touchring::MAX_TOUCHES);
+		memcpy(slot->frame.touches, touches, slot->frame.count * sizeof(TouchRingTouch));
+
+		slot->sequence.store(2 * n + 2, std::memory_order_release);
+		Header()->latest.store(n, std::memory_order_release);
+	}
+
+private:
+	TouchRingHeader* Header() { return (TouchRingHeader*)data_; }
+	TouchRingSlot* Slot(uint32_t i) { return (TouchRingSlot*)(data_ + sizeof(TouchRingHeader)) + i; }
+
+	uint8_t* data_;
+	void* handle_;
+	std::string name_;
+	uint64_t frame_;
+};
+
+/*
+ Consumer side. Poll Latest() as often as you like, it is a single load;
+ ReadLatest() costs one copy of the frame's touches.
+*/
+class TouchRingReader
+{
+public:
+	TouchRingReader() : data_(NULL), handle_(NULL) {}
+	~TouchRingReader() { Close(); }
+
+	// fails until the tracker has created the ring
+	bool Open(const std::string& name = touchring::DEFAULT_NAME) {
+		Close();
+		data_ = touchring::Map(name, false, &handle_);
+		if (data_ == NULL)
+			return false;
+
+		const TouchRingHeader* header = Header();
+		if (memcmp(header->magic, touchring::MAGIC, sizeof(touchring::MAGIC)) != 0
+			|| header->version != touchring::VERSION
+			|| header->slots != touchring::SLOTS
+			|| header->maxTouches != touchring::MAX_TOUCHES
+			|| header->slotSize != sizeof(TouchRingSlot)) {
+			Close();
+			return false;
+		}
+		std::atomic_thread_fence(std::memory_order_acquire);
+		return true;
+	}
+
+	void Close() {
+		if (data_ == NULL) return;
+		touchring::Unmap(data_, handle_);
+		data_ = NULL;
+	}
+
+	bool IsOpen() const { return data_ != NULL; }
+
+	// newest complete frame, 0 before the first
+	uint64_t Latest() const { return Header()->latest.load(std::memory_order_acquire); }
+
+	uint64_t ClockBase() const { return Header()->clockBase; }
+
+	// false once frame n was overwritten, i.e. more than SLOTS frames ago
+	bool Read(uint64_t n, TouchRingFrame& out) const {
+		const TouchRingSlot* slot = Slot((uint32_t)(n % touchring::SLOTS));
+		// bounded, a tracker that died mid-write leaves the slot odd for good
+		for (int attempt = 0; attempt < 1000; attempt++) {
+			const uint64_t before = slot->sequence.load(std::memory_order_acquire);
+			if (before != 2 * n + 2) {
+				// still being written: wait for it; anything else is gone or not there yet
+				if (before == 2 * n + 1) {
+					std::this_thread::yield();
+					continue;
+				}
+				return false;
+			}
+
+			out.frame = slot->frame.frame;
+			out.timestamp = slot->frame.timestamp;
+			out.count = std::min(slot->frame.count, touchring::MAX_TOUCHES);
+			memcpy(out.touches, slot->frame.touches, out.count * sizeof(TouchRingTouch));
+			std::atomic_thread_fence(std::memory_order_acquire);
+
+			if (slot->sequence.load(std::memory_order_relaxed) == before)
+				return true;
+		}
+		return false;
+	}
+
+	bool ReadLatest(TouchRingFrame& out) const {
+		uint64_t n = Latest();
+		while (n != 0) {
+			if (Read(n, out))
+				return true;
+			// lapped while copying, try the frame that replaced it
+			const uint64_t latest = Latest();
+			if (latest == n)
+				return false;
+			n = latest;
+		}
+		return false;
+	}
+
+private:
+	const TouchRingHeader* Header() const { return (const TouchRingHeader*)data_; }
+	const TouchRingSlot* Slot(uint32_t i) const { return (const TouchRingSlot*)(data_ + sizeof(TouchRingHeader)) + i; }
+
+	uint8_t* data_;
+	void* handle_;
+};
@@ -0,0 +1,191 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <vector>
+
+struct TrackingScoreStats {
+	uint64_t frames;	// scored frames, i.e. with ground truth still available
+	uint64_t truth;	// ground truth touches that should have been reported
+	uint64_t matched;
+	uint64_t missed;
+	uint64_t falsePositives;	// reported touches without a finger underneath
+	uint64_t idSwitches;	// a finger reported under a different label than before
+	float meanError;	// of matched touches, in tracker pixels
+	float fps;	// scored frames per second of wall time
+};
+
+/*
+ Compares the tracker's output against the touches a MySyntheticCam
+ rendered into the same frame. Hook Score() up as the tracker's output
+ listener.
+
+ Ground truth is mapped into the tracker's warped image with the same
+ homography and downscale the tracker uses, then matched to the reported
+ touches closest first within the tolerance. Fingers younger than the
+ warmup have not had the frames the tracker needs to confirm a touch:
+ they may match, but are not counted as missed.
+*/
+class TrackingScore
+{
+public:
+	explicit TrackingScore(const MySyntheticCam* camera)
+		: camera_(camera),
+		pm_(cv::Mat::eye(3, 3, CV_64F)),
+		scale_(1, 1),
+		tolerance_(4),
+		warmup_(0.6f) {
+		Reset();
+	}
+
+	// camera -> tracker image, as in FingerTracker::GetPerspective(), GetCameraSize() and GetProcSize()
+	void SetMapping(const cv::Mat& pm, cv::Size cameraSize, cv::Size procSize) {
+		std::lock_guard<std::mutex> guard(mutex_);
+		pm.convertTo(pm_, CV_64F);
+		scale_ = cv::Point2f((float)procSize.width / cameraSize.width, (float)procSize.height / cameraSize.height);
+	}
+
+	// in tracker pixels
+	void SetTolerance(float tolerance) { tolerance_ = tolerance; }
+	// seconds
+	void SetWarmup(float warmup) { warmup_ = warmup; }
+
+	// output stage of the tracker
+	void Score(const TrackerFrame& frame) {
+		if (!camera_->GetGroundTruth(frame.sequence, truth_))
+			return;
+
+		std::lock_guard<std::mutex> guard(mutex_);
+		if (stats_.frames == 0)
+			start_ = std::chrono::steady_clock::now();
+		stats_.frames++;
+
+		Map();
+		reported_.clear();
+		for (const auto& touch : frame.touches) {
+			if (touch.state == FingerFollowers::BORN || touch.state == FingerFollowers::ALIVE)
+				reported_.push_back(&touch);
+		}
+
+		// all pairs within the tolerance, closest first
+		const float tolerance2 = tolerance_ * tolerance_;
+		pairs_.clear();
+		for (size_t t = 0; t < points_.size(); t++) {
+			for (size_t r = 0; r < reported_.size(); r++) {
+				const float ex = reported_[r]->pos.x - points_[t].x;
+				const float ey = reported_[r]->pos.y - points_[t].y;
+				const float d2 = ex * ex + ey * ey;
+				if (d2 <= tolerance2)
+					pairs_.push_back(Pair{ d2, (int)t, (int)r });
+			}
+		}
+		std::sort(pairs_.begin(), pairs_.end(), [](const Pair& a, const Pair& b) {
+			if (a.distance != b.distance) return a.distance < b.distance;
+			if (a.truth != b.truth) return a.truth < b.truth;
+			return a.reported < b.reported;
+			});
+
+		truthMatched_.assign(points_.size(), false);
+		reportedMatched_.assign(reported_.size(), false);
+		for (const auto& p : pairs_) {
+			if (truthMatched_[p.truth] || reportedMatched_[p.reported])
+				continue;
+			truthMatched_[p.truth] = true;
+			reportedMatched_[p.reported] = true;
+
+			const SyntheticTouch& truth = truth_[p.truth];
+			const int label = reported_[p.reported]->label;
+			auto last = labels_.find(truth.id);
+			if (last != labels_.end() && last->second != label)
+				stats_.idSwitches++;
+			labels_[truth.id] = label;
+
+			if (truth.age >= warmup_) {
+				stats_.matched++;
+				errorSum_ += sqrtf(p.distance);
+			}
+		}
+
+		for (size_t t = 0; t < points_.size(); t++) {
+			if (truth_[t].age < warmup_)
+				continue;
+			stats_.truth++;
+			if (!truthMatched_[t])
+				stats_.missed++;
+		}
+		for (size_t r = 0; r < reported_.size(); r++) {
+			if (!reportedMatched_[r])
+				stats_.falsePositives++;
+		}
+
+		// fingers that lifted off never come back under the same id
+		if (labels_.size() > 4 * truth_.size() + 64) {
+			std::map<int, int> alive;
+			for (const auto& truth : truth_) {
+				auto label = labels_.find(truth.id);
+				if (label != labels_.end())
+					alive.insert(*label);
+			}
+			labels_.swap(alive);
+		}
+	}
+
+	// any thread
+	TrackingScoreStats Stats() const {
+		std::lock_guard<std::mutex> guard(mutex_);
+		TrackingScoreStats stats = stats_;
+		stats.meanError = (stats_.matched != 0) ? (float)(errorSum_ / stats_.matched) : 0;
+		const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_).count();
+		stats.fps = (stats_.frames > 1 && elapsed > 0) ? (float)((stats_.frames - 1) / elapsed) : 0;
+		return stats;
+	}
+
+	void Reset() {
+		std::lock_guard<std::mutex> guard(mutex_);
+		stats_ = TrackingScoreStats();
+		errorSum_ = 0;
+		labels_.clear();
+	}
+
+private:
+	struct Pair {
+		float distance;	// squared
+		int truth;
+		int reported;
+	};
+
+	void Map() {
+		points_.clear();
+		const double* h = pm_.ptr<double>(0);
+		for (const auto& truth : truth_) {
+			const double w = h[6] * truth.x + h[7] * truth.y + h[8];
+			const double iw = (w != 0) ? 1.0 / w : 0.0;
+			const float x = (float)((h[0] * truth.x + h[1] * truth.y + h[2]) * iw);
+			const float y = (float)((h[3] * truth.x + h[4] * truth.y + h[5]) * iw);
+			points_.push_back(cv::Point2f(x * scale_.x, y * scale_.y));
+		}
+	}
+
+	const MySyntheticCam* camera_;
+
+	mutable std::mutex mutex_;
+	cv::Mat pm_;
+	cv::Point2f scale_;
+	float tolerance_;
+	float warmup_;
+
+	TrackingScoreStats stats_;
+	double errorSum_;
+	std::chrono::steady_clock::time_point start_;
+	std::map<int, int> labels_;	// ground truth id -> last matched tracker label
+
+	std::vector<SyntheticTouch> truth_;
+	std::vector<cv::Point2f> points_;
+	std::vector<const TouchPoint*> reported_;
+	std::vector<Pair> pairs_;
+	std::vector<bool> truthMatched_;
+	std::vector<bool> reportedMatched_;
+};
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <atomic>
+
+/*
+ Single-writer / single-reader triple buffer.
+
+ The writer fills Back() and publishes it, the reader picks up the newest
+ published item with Consume() and reads Front(). Publishing swaps the
+ back slot with the shared middle slot, consuming swaps the front slot
+ with it, so neither side ever waits for the other and the reader always
+ sees the most recent complete item.
+*/
+template <class T>
+class TripleBuffer
+{
+public:
+	TripleBuffer() : back_(0), middle_(1), front_(2) {}
+
+	// writer side
+	T& Back() { return items_[back_]; }
+
+	void Publish() {
+		back_ = middle_.exchange(back_ | DIRTY, std::memory_order_acq_rel) & INDEX;
+	}
+
+	// reader side, returns false when nothing new was published since the last call
+	bool Consume() {
+		if ((middle_.load(std::memory_order_relaxed) & DIRTY) == 0)
+			return false;
+
+		front_ = middle_.exchange(front_, std::memory_order_acq_rel) & INDEX;
+		return true;
+	}
+
+	T& Front() { return items_[front_]; }
+
+	// neither side may be active; empties all three slots, e.g. to drop
+	// handles before what they point to goes away
+	void Reset() {
+		for (auto& item : items_)
+			item = T();
+		back_ = 0;
+		middle_ = 1;
+		front_ = 2;
+	}
+
+private:
+	enum { INDEX = 3, DIRTY = 4 };
+
+	T items_[3];
+	int back_;
+	std::atomic<int> middle_;
+	int front_;
+};
@@ -0,0 +1,196 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "osc/OscOutboundPacketStream.h"
+
+struct TuioEncoderConfig {
+	int mtu = 1472;	// UDP payload per datagram, 1500 byte Ethernet frame minus IP and UDP headers
+	float epsilon = 0.0005f;	// normalized distance a cursor must move before its set is sent again
+	float refresh = 1.0f;	// seconds after which an unchanged cursor is sent anyway
+};
+
+/*
+ TUIO 1.1 /tuio/2Dcur encoder for large numbers of cursors.
+
+ A frame that does not fit into one datagram is split into several
+ bundles. Every bundle carries the source and set messages; intermediate
+ ones end with "fseq -1", which receivers apply at once, and only the last
+ holds the alive list and the real frame number. Unlike the reference
+ server the alive list is not repeated in every bundle, with hundreds of
+ cursors it would fill most of each datagram. It is also the one message
+ that can't be split, so it goes out whole even when that makes the last
+ datagram exceed the MTU.
+
+ A set is only sent for cursors that are new, moved by more than epsilon,
+ or were not sent for the refresh interval, so an idle or slowly moving
+ crowd costs little more than its alive list. Stale cursors come due at
+ different times, which spreads the refresh over many frames.
+*/
+class TuioCursorEncoder
+{
+public:
+	typedef std::function<void(const char* data, size_t size)> Sink;
+
+	TuioCursorEncoder(const TuioEncoderConfig& config, Sink sink, const std::string& source = "ofTracker")
+		: config_(config), sink_(sink), source_(source), frame_(0), time_(0) {}
+
+	// starts a frame at time in seconds
+	void Begin(double time) {
+		time_ = time;
+		alive_.clear();
+	}
+
+	// a touching cursor, position normalized to 0..1, velocity per second
+	void Add(osc::int32 id, float x, float y, float vx, float vy) {
+		Cursor& c = cursors_[id];
+		const float speed = sqrtf(vx * vx + vy * vy);
+		const float dt = (float)(time_ - c.time);
+		const bool known = c.frame != 0;
+
+		Alive a;
+		a.id = id;
+		a.x = x;
+		a.y = y;
+		a.vx = vx;
+		a.vy = vy;
+		a.accel = (known && dt > 0) ? (speed - c.speed) / dt : 0;
+		a.dirty = !known
+			|| fabsf(x - c.sentX) > config_.epsilon || fabsf(y - c.sentY) > config_.epsilon
+			|| time_ - c.sentTime >= config_.refresh;
+		alive_.push_back(a);
+
+		c.speed = speed;
+		c.time = time_;
+		c.frame = frame_ + 1;
+		if (a.dirty) {
+			c.sentX = x;
+			c.sentY = y;
+			c.sentTime = time_;
+		}
+	}
+
+	// encodes the frame and hands every datagram to the sink; cursors not added
+	// since Begin() are removed
+	void Commit() {
+		frame_++;
+		Forget();
+
+		sets_.clear();
+		for (size_t i = 0; i < alive_.size(); i++) {
+			if (alive_[i].dirty)
+				sets_.push_back((int)i);
+		}
+
+		const size_t mtu = (size_t)std::max(config_.mtu, 0);
+		const size_t fixed = BUNDLE_SIZE + SourceSize() + FSEQ_SIZE;
+		const size_t alive = AliveSize();
+		const size_t perBundle = (mtu > fixed + SET_SIZE) ? (mtu - fixed) / SET_SIZE : 1;
+		const size_t finalRoom = (mtu > fixed + alive) ? (mtu - fixed - alive) / SET_SIZE : 0;
+
+		// intermediate bundles until the rest fits next to the alive list
+		size_t next = 0;
+		while (sets_.size() - next > finalRoom) {
+			const size_t count = std::min(perBundle, sets_.size() - next - finalRoom);
+			Reserve(fixed + count * SET_SIZE);
+			osc::OutboundPacketStream p(buffer_.data(), buffer_.size());
+			p << osc::BeginBundleImmediate;
+			WriteSource(p);
+			for (size_t i = next; i < next + count; i++)
+				WriteSet(p, alive_[sets_[i]]);
+			p << osc::BeginMessage("/tuio/2Dcur") << "fseq" << (osc::int32)-1 << osc::EndMessage;
+			p << osc::EndBundle;
+			sink_(p.Data(), p.Size());
+			next += count;
+		}
+
+		Reserve(fixed + alive + (sets_.size() - next) * SET_SIZE);
+		osc::OutboundPacketStream p(buffer_.data(), buffer_.size());
+		p << osc::BeginBundleImmediate;
+		WriteSource(p);
+		p << osc::BeginMessage("/tuio/2Dcur") << "alive";
+		for (const auto& a : alive_)
+			p << a.id;
+		p << osc::EndMessage;
+		for (size_t i = next; i < sets_.size(); i++)
+			WriteSet(p, alive_[sets_[i]]);
+		p << osc::BeginMessage("/tuio/2Dcur") << "fseq" << frame_ << osc::EndMessage;
+		p << osc::EndBundle;
+		sink_(p.Data(), p.Size());
+	}
+
+	osc::int32 Frame() const { return frame_; }
+
+private:
+	// sizes as encoded by oscpack, element size prefix included
+	enum {
+		BUNDLE_SIZE = 16,	// "#bundle", time tag
+		SET_SIZE = 4 + 12 + 12 + 4 + 4 + 5 * 4,	// address, ",sifffff", "set", s, x y X Y m
+		FSEQ_SIZE = 4 + 12 + 4 + 8 + 4	// address, ",si", "fseq", f
+	};
+
+	struct Cursor {
+		float sentX = 0, sentY = 0;
+		double sentTime = 0;
+		float speed = 0;
+		double time = 0;	// of the last Add()
+		osc::int32 frame = 0;	// the last Add() was for, 0 before the first
+	};
+
+	struct Alive {
+		osc::int32 id;
+		float x, y, vx, vy, accel;
+		bool dirty;
+	};
+
+	static size_t Padded(size_t size) { return (size + 3) & ~(size_t)3; }
+
+	size_t SourceSize() const {
+		return 4 + 12 + 4 + 8 + Padded(source_.size() + 1);
+	}
+
+	size_t AliveSize() const {
+		return 4 + 12 + Padded(2 + alive_.size() + 1) + 8 + 4 * alive_.size();
+	}
+
+	void Reserve(size_t size) {
+		// a little slack, oscpack throws rather than truncates
+		if (buffer_.size() < size + 64)
+			buffer_.resize(size + 64);
+	}
+
+	void WriteSource(osc::OutboundPacketStream& p) const {
+		p << osc::BeginMessage("/tuio/2Dcur") << "source" << source_.c_str() << osc::EndMessage;
+	}
+
+	static void WriteSet(osc::OutboundPacketStream& p, const Alive& a) {
+		p << osc::BeginMessage("/tuio/2Dcur") << "set" << a.id << a.x << a.y << a.vx << a.vy << a.accel << osc::EndMessage;
+	}
+
+	// drops the state of cursors that were not added this frame
+	void Forget() {
+		for (auto it = cursors_.begin(); it != cursors_.end();) {
+			if (it->second.frame != frame_)
+				it = cursors_.erase(it);
+			else
+				++it;
+		}
+	}
+
+	TuioEncoderConfig config_;
+	Sink sink_;
+	std::string source_;
+	osc::int32 frame_;
+	double time_;
+
+	std::unordered_map<osc::int32, Cursor> cursors_;
+	std::vector<Alive> alive_;
+	std::vector<int> sets_;
+	std::vector<char> buffer_;
+};
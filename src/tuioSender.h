@@ -0,0 +1,192 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct TuioDestination {
+	std::string host;
+	int port;
+};
+
+// where and how cursors are sent, fixed once the tracker runs
+struct TuioOutputConfig {
+	bool bundled = false;	// TuioCursorEncoder instead of TUIO::TuioServer, for many cursors
+	std::vector<TuioDestination> destinations = { { "127.0.0.1", 3333 } };
+	TuioEncoderConfig encoder;
+};
+
+// a touching cursor, already predicted and normalized to 0..1
+struct TuioSnapshotCursor {
+	int id;
+	float x, y;
+	float vx, vy;	// per second
+};
+
+struct TuioSnapshot {
+	uint64_t timestamp;	// camera timestamp of the frame, in ofGetElapsedTimeMicros()
+	std::vector<TuioSnapshotCursor> cursors;
+};
+
+struct TuioDestinationStats {
+	TuioDestination destination;
+	uint64_t sent;	// frames
+	uint64_t dropped;	// frames skipped because the destination fell behind
+};
+
+/*
+ Sends tracker output to any number of UDP receivers, each from its own
+ thread with its own queue of snapshots. Send() only copies the snapshot
+ into every queue: a receiver that can't keep up, or a socket that
+ blocks, loses frames of its own and never holds up the tracker or the
+ other receivers.
+
+ Snapshots hold the full set of touching cursors rather than add/remove
+ events, so each destination derives its own session changes and stays
+ consistent across dropped frames.
+*/
+class TuioSender
+{
+public:
+	enum { QUEUE_SIZE = 8 };
+
+	TuioSender() : running_(false) {}
+	~TuioSender() { Stop(); }
+
+	void Start(const TuioOutputConfig& config) {
+		Stop();
+
+		std::lock_guard<std::mutex> guard(mutex_);
+		config_ = config;
+		running_ = true;
+		for (const auto& address : config_.destinations) {
+			destinations_.push_back(std::make_unique<Destination>());
+			Destination& d = *destinations_.back();
+			d.address = address;
+			d.thread = std::thread(&TuioSender::Run, this, std::ref(d));
+		}
+	}
+
+	void Stop() {
+		if (!running_) return;
+		std::lock_guard<std::mutex> guard(mutex_);
+		running_ = false;
+		for (auto& d : destinations_) {
+			d->queue.Wake();
+			d->thread.join();
+		}
+		destinations_.clear();
+	}
+
+	// Single producer between Start() and Stop(), never blocks. The queues
+	// hand their buffers back and forth with the senders, so once every slot
+	// has held the largest frame, sending no longer allocates.
+	void Send(const TuioSnapshot& snapshot) {
+		for (auto& d : destinations_) {
+			if (!d->queue.Push(snapshot))
+				d->dropped++;
+		}
+	}
+
+	// any thread
+	std::vector<TuioDestinationStats> GetStats() const {
+		std::lock_guard<std::mutex> guard(mutex_);
+		std::vector<TuioDestinationStats> stats;
+		for (auto& d : destinations_) {
+			TuioDestinationStats s;
+			s.destination = d->address;
+			s.sent = d->sent;
+			s.dropped = d->dropped;
+			stats.push_back(s);
+		}
+		return stats;
+	}
+
+private:
+	struct Destination {
+		TuioDestination address;
+		SpscRing<TuioSnapshot, QUEUE_SIZE> queue;
+		std::thread thread;
+		std::atomic<uint64_t> sent{ 0 };
+		std::atomic<uint64_t> dropped{ 0 };
+	};
+
+	// the sockets and the TUIO session state live on the destination's thread
+	void Run(Destination& d) {
+		try {
+			if (config_.bundled)
+				RunEncoder(d);
+			else
+				RunServer(d);
+		}
+		catch (std::exception& e) {
+			// unresolvable host or no socket; the queue fills up and counts the drops
+			printf("tuio: %s:%d disabled, %s\n", d.address.host.c_str(), d.address.port, e.what());
+		}
+	}
+
+	void RunEncoder(Destination& d) {
+		UdpTransmitSocket socket(IpEndpointName(d.address.host.c_str(), d.address.port));
+		TuioCursorEncoder encoder(config_.encoder, [&socket](const char* data, size_t size) {
+			socket.Send(data, size);
+			});
+
+		TuioSnapshot snapshot;
+		while (running_) {
+			if (!d.queue.WaitPopSwap(snapshot, std::chrono::milliseconds(100)))
+				continue;
+
+			encoder.Begin(snapshot.timestamp * 1e-6);
+			for (const auto& c : snapshot.cursors)
+				encoder.Add(c.id, c.x, c.y, c.vx, c.vy);
+			encoder.Commit();
+			d.sent++;
+		}
+	}
+
+	void RunServer(Destination& d) {
+		TUIO::TuioServer server(d.address.host.c_str(), d.address.port);
+		server.setSourceName("ofTracker");
+		server.enableObjectProfile(false);
+		server.enableBlobProfile(false);
+
+		std::map<int, TUIO::TuioCursor*> cursors;
+		std::map<int, TUIO::TuioCursor*> alive;
+		TuioSnapshot snapshot;
+		while (running_) {
+			if (!d.queue.WaitPopSwap(snapshot, std::chrono::milliseconds(100)))
+				continue;
+
+			server.initFrame(TUIO::TuioTime::getSessionTime());
+			alive.clear();
+			for (const auto& c : snapshot.cursors) {
+				auto cursor = cursors.find(c.id);
+				if (cursor == cursors.end()) {
+					alive[c.id] = server.addTuioCursor(c.x, c.y);
+				}
+				else {
+					server.updateTuioCursor(cursor->second, c.x, c.y);
+					alive[c.id] = cursor->second;
+					cursors.erase(cursor);
+				}
+			}
+			// whatever is left was lifted
+			for (auto& cursor : cursors)
+				server.removeTuioCursor(cursor.second);
+			cursors.swap(alive);
+			server.commitFrame();
+			d.sent++;
+		}
+	}
+
+	TuioOutputConfig config_;
+	std::vector<std::unique_ptr<Destination>> destinations_;
+	std::atomic<bool> running_;
+	mutable std::mutex mutex_;	// destinations_ against GetStats()
+};